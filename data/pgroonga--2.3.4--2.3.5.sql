@@ -1 +1,46 @@
 -- Upgrade SQL
+
+CREATE FUNCTION pgroonga_query_score_distance_text(text, text)
+	RETURNS float8
+	AS 'MODULE_PATHNAME', 'pgroonga_query_score_distance_text'
+	LANGUAGE C
+	IMMUTABLE
+	STRICT
+	PARALLEL SAFE
+	COST 300;
+
+CREATE OPERATOR <&@~> (
+	PROCEDURE = pgroonga_query_score_distance_text,
+	LEFTARG = text,
+	RIGHTARG = text
+);
+
+ALTER OPERATOR FAMILY pgroonga_text_full_text_search_ops_v2 USING pgroonga
+	ADD
+		OPERATOR 37 <&@~> (text, text) FOR ORDER BY pg_catalog.float_ops;
+
+CREATE OPERATOR CLASS pgroonga_text_full_text_search_ordered_ops_v2
+	FOR TYPE text
+	USING pgroonga AS
+		OPERATOR 1 <, -- For ORDER BY index columns
+		OPERATOR 6 ~~,
+		OPERATOR 7 ~~*,
+		OPERATOR 12 &@,
+		OPERATOR 15 &`,
+		OPERATOR 18 &@| (text, text[]),
+		OPERATOR 28 &@~,
+		OPERATOR 29 &@*,
+		OPERATOR 30 &@~| (text, text[]),
+		OPERATOR 31 &@ (text, pgroonga_full_text_search_condition),
+		OPERATOR 32 &@~ (text, pgroonga_full_text_search_condition),
+		OPERATOR 33 &@ (text, pgroonga_full_text_search_condition_with_scorers),
+		OPERATOR 34 &@~ (text, pgroonga_full_text_search_condition_with_scorers);
+
+CREATE FUNCTION pgroonga_condition_cache_status(OUT hits bigint,
+												OUT misses bigint,
+												OUT n_entries integer)
+	RETURNS record
+	AS 'MODULE_PATHNAME', 'pgroonga_condition_cache_status'
+	LANGUAGE C
+	VOLATILE
+	STRICT;
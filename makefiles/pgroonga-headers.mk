@@ -4,6 +4,7 @@ HEADERS =					\
 	src/pgrn-column-name.h			\
 	src/pgrn-command-escape-value.h		\
 	src/pgrn-compatible.h			\
+	src/pgrn-condition-cache.h		\
 	src/pgrn-convert.h			\
 	src/pgrn-crash-safer-statuses.h		\
 	src/pgrn-create.h			\
@@ -21,7 +22,9 @@ HEADERS =					\
 	src/pgrn-match-positions-byte.h		\
 	src/pgrn-match-positions-character.h	\
 	src/pgrn-normalize.h			\
+	src/pgrn-object-cache.h			\
 	src/pgrn-options.h			\
+	src/pgrn-pending-list.h			\
 	src/pgrn-pg.h				\
 	src/pgrn-portable.h			\
 	src/pgrn-query-expand.h			\
@@ -3,6 +3,7 @@ SRCS =						\
 	src/pgrn-auto-close.c			\
 	src/pgrn-column-name.c			\
 	src/pgrn-command-escape-value.c		\
+	src/pgrn-condition-cache.c		\
 	src/pgrn-convert.c			\
 	src/pgrn-create.c			\
 	src/pgrn-ctid.c				\
@@ -20,7 +21,9 @@ SRCS =						\
 	src/pgrn-match-positions-byte.c		\
 	src/pgrn-match-positions-character.c	\
 	src/pgrn-normalize.c			\
+	src/pgrn-object-cache.c			\
 	src/pgrn-options.c			\
+	src/pgrn-pending-list.c			\
 	src/pgrn-pg.c				\
 	src/pgrn-query-escape.c			\
 	src/pgrn-query-expand.c			\
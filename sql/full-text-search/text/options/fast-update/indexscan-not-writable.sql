@@ -0,0 +1,28 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+
+CREATE INDEX pgrn_index ON memos
+  USING pgroonga (content)
+  WITH (fast_update = true);
+
+INSERT INTO memos VALUES (2, 'Groonga is fast full text search engine.');
+INSERT INTO memos VALUES (3, 'PGroonga is a PostgreSQL extension that uses Groonga.');
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+SELECT pgroonga_set_writable(false);
+
+SELECT id, content
+  FROM memos
+ WHERE content &@ 'Groonga'
+ ORDER BY id;
+
+SELECT pgroonga_set_writable(true);
+
+DROP TABLE memos;
@@ -0,0 +1,27 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+CREATE INDEX pgrn_index ON memos
+  USING pgroonga (content)
+  WITH (fast_update = true);
+
+SET pgroonga.pending_list_limit = 2;
+
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+INSERT INTO memos VALUES (2, 'Groonga is fast full text search engine.');
+INSERT INTO memos VALUES (3, 'PGroonga is a PostgreSQL extension that uses Groonga.');
+
+SELECT pgroonga_command('select',
+                        ARRAY[
+                          'table',
+                          pgroonga_table_name('pgrn_index'),
+                          'output_columns',
+                          'content'
+                        ])::json->>1
+    AS body;
+
+RESET pgroonga.pending_list_limit;
+
+DROP TABLE memos;
@@ -0,0 +1,33 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+CREATE INDEX pgrn_index ON memos
+  USING pgroonga (content)
+  WITH (fast_update = true);
+
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+INSERT INTO memos VALUES (2, 'Groonga is fast full text search engine.');
+
+SELECT pgroonga_command('select',
+                        ARRAY[
+                          'table',
+                          pgroonga_table_name('pgrn_index'),
+                          'output_columns',
+                          'content'
+                        ])::json->>1
+    AS body;
+
+VACUUM memos;
+
+SELECT pgroonga_command('select',
+                        ARRAY[
+                          'table',
+                          pgroonga_table_name('pgrn_index'),
+                          'output_columns',
+                          'content'
+                        ])::json->>1
+    AS body;
+
+DROP TABLE memos;
@@ -0,0 +1,26 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos VALUES (1, 'Groonga');
+INSERT INTO memos VALUES (2, 'Groonga Groonga Groonga');
+INSERT INTO memos VALUES (3, 'PostgreSQL');
+INSERT INTO memos VALUES (4, 'Groonga Groonga');
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+SELECT id, content
+  FROM memos
+ WHERE content &@ 'Groonga';
+
+SELECT id, content, pgroonga_score(tableoid, ctid)
+  FROM memos
+ WHERE content &@ 'Groonga';
+
+DROP TABLE memos;
@@ -0,0 +1,25 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos VALUES (1, 'Groonga');
+INSERT INTO memos VALUES (2, 'Groonga Groonga Groonga');
+INSERT INTO memos VALUES (3, 'Groonga Groonga');
+INSERT INTO memos VALUES (4, 'PostgreSQL');
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+SELECT id, content
+  FROM (SELECT id, content
+          FROM memos
+         ORDER BY content <&@~> 'Groonga'
+         LIMIT 4) AS scored_memos
+ ORDER BY id;
+
+DROP TABLE memos;
@@ -0,0 +1,24 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos VALUES (1, 'Groonga');
+INSERT INTO memos VALUES (2, 'Groonga Groonga Groonga');
+INSERT INTO memos VALUES (3, 'Groonga Groonga');
+INSERT INTO memos VALUES (4, 'PostgreSQL');
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+SET enable_seqscan = on;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+SELECT id, content
+  FROM memos
+ WHERE content &@~ 'Groonga'
+ ORDER BY content <&@~> 'Groonga', id
+ LIMIT 2;
+
+DROP TABLE memos;
@@ -0,0 +1,27 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos
+  SELECT i,
+         CASE WHEN i % 3 = 0 THEN 'PostgreSQL' ELSE 'Groonga' END
+    FROM generate_series(1, 20000) AS i;
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = on;
+
+EXPLAIN (COSTS OFF)
+SELECT count(*)
+  FROM memos
+ WHERE content &@~ 'Groonga';
+
+SELECT count(*)
+  FROM memos
+ WHERE content &@~ 'Groonga';
+
+DROP TABLE memos;
@@ -0,0 +1,22 @@
+CREATE TABLE memos (
+  id integer PRIMARY KEY,
+  content text
+);
+
+CREATE INDEX pgroonga_index ON memos
+ USING pgroonga (content, id);
+
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+INSERT INTO memos VALUES (2, 'Groonga is fast full text search engine.');
+INSERT INTO memos VALUES (3, 'PGroonga uses Groonga. Groonga is fast.');
+DELETE FROM memos WHERE id = 1;
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+SELECT id, content, pgroonga_score(memos)
+  FROM memos
+ WHERE content &@ 'Groonga';
+
+DROP TABLE memos;
@@ -0,0 +1,45 @@
+SET pgroonga.enable_wal = yes;
+SET pgroonga.wal_compression_threshold = 64;
+
+CREATE TABLE memos (
+  content text
+);
+
+INSERT INTO memos VALUES (repeat('Groonga is fast! ', 10));
+
+CREATE INDEX pgrn_index ON memos USING PGroonga (content);
+
+INSERT INTO memos VALUES (repeat('PGroonga is also fast! ', 10));
+
+SELECT pgroonga_command('delete',
+                        ARRAY[
+                          'table', 'IndexStatuses',
+                          'key', 'pgrn_index'::regclass::oid::text
+                        ])::jsonb->>1;
+SELECT pgroonga_command('table_remove',
+                        ARRAY[
+                          'name', 'Lexicon' ||
+                                  'pgrn_index'::regclass::oid ||
+                                  '_0'
+                        ])::jsonb->>1;
+SELECT pgroonga_command('table_remove',
+                        ARRAY[
+                          'name', pgroonga_table_name('pgrn_index')
+                        ])::jsonb->>1;
+
+SELECT pgroonga_wal_apply('pgrn_index');
+
+SELECT (pgroonga_command('select',
+                         ARRAY[
+                           'table', pgroonga_table_name('pgrn_index'),
+                           'output_columns', 'content'
+                         ])::jsonb->1->0->2->>0) =
+         repeat('Groonga is fast! ', 10) AS first,
+       (pgroonga_command('select',
+                         ARRAY[
+                           'table', pgroonga_table_name('pgrn_index'),
+                           'output_columns', 'content'
+                         ])::jsonb->1->0->3->>0) =
+         repeat('PGroonga is also fast! ', 10) AS second;
+
+DROP TABLE memos;
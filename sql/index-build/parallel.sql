@@ -0,0 +1,27 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos
+  SELECT i,
+         CASE WHEN i % 3 = 0 THEN 'Groonga is fast.'
+              ELSE 'PostgreSQL is a RDBMS.'
+         END
+    FROM generate_series(1, 10000) AS i;
+
+ALTER TABLE memos SET (parallel_workers = 2);
+SET max_parallel_maintenance_workers = 2;
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+SELECT count(*), count(DISTINCT id)
+  FROM memos
+ WHERE content &@~ 'groonga';
+
+DROP TABLE memos;
@@ -0,0 +1,25 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+INSERT INTO memos VALUES (2, 'Groonga is fast full text search engine.');
+INSERT INTO memos VALUES (3, 'PGroonga is a PostgreSQL extension that uses Groonga.');
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+UPDATE memos SET content = 'Groonga is very fast full text search engine.'
+ WHERE id = 2;
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+SET pgroonga.enable_heap_order_scan = on;
+
+SELECT ctid, id, content
+  FROM memos
+ WHERE content &@~ 'groonga';
+
+DROP TABLE memos;
@@ -0,0 +1,39 @@
+CREATE TABLE memos (
+  id integer NOT NULL,
+  content text
+);
+
+INSERT INTO memos VALUES (2, 'Groonga is fast.');
+INSERT INTO memos VALUES (5, 'PGroonga uses Groonga.');
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+INSERT INTO memos VALUES (4, 'Groonga is a full text search engine.');
+INSERT INTO memos VALUES (3, 'Mroonga uses Groonga.');
+INSERT INTO memos VALUES (6, 'Rroonga uses Groonga.');
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (id, content pgroonga_text_full_text_search_ordered_ops_v2);
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+EXPLAIN (COSTS OFF)
+SELECT id, content
+  FROM memos
+ WHERE content &@~ 'groonga'
+ ORDER BY id DESC
+ LIMIT 3;
+
+SELECT id, content
+  FROM memos
+ WHERE content &@~ 'groonga'
+ ORDER BY id DESC
+ LIMIT 3;
+
+SELECT id, content
+  FROM memos
+ WHERE content &@~ 'groonga'
+ ORDER BY id ASC
+ LIMIT 3;
+
+DROP TABLE memos;
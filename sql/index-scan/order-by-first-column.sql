@@ -0,0 +1,39 @@
+CREATE TABLE memos (
+  id integer NOT NULL,
+  title text
+);
+
+INSERT INTO memos VALUES (2, 'Groonga is fast.');
+INSERT INTO memos VALUES (5, 'Groonga is used by PGroonga.');
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+INSERT INTO memos VALUES (4, 'Groonga is a full text search engine.');
+INSERT INTO memos VALUES (3, 'Groonga is used by Mroonga.');
+INSERT INTO memos VALUES (6, 'Groonga is used by Rroonga.');
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (id, title pgroonga_text_term_search_ops_v2);
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+EXPLAIN (COSTS OFF)
+SELECT id, title
+  FROM memos
+ WHERE title &^ 'Groonga'
+ ORDER BY id DESC
+ LIMIT 3;
+
+SELECT id, title
+  FROM memos
+ WHERE title &^ 'Groonga'
+ ORDER BY id DESC
+ LIMIT 3;
+
+SELECT id, title
+  FROM memos
+ WHERE title &^ 'Groonga'
+ ORDER BY id ASC
+ LIMIT 3;
+
+DROP TABLE memos;
@@ -0,0 +1,48 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2)
+ WITH (fast_update = true);
+
+SET pgroonga.pending_list_limit = 100000;
+
+INSERT INTO memos
+  SELECT i,
+         CASE WHEN i % 3 = 0 THEN 'Groonga is fast.'
+              ELSE 'PostgreSQL is a RDBMS.'
+         END
+    FROM generate_series(1, 10000) AS i;
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_index_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+
+SELECT count(*), count(DISTINCT id)
+  FROM memos
+ WHERE content &@~ 'groonga';
+
+INSERT INTO memos
+  SELECT i,
+         CASE WHEN i % 3 = 0 THEN 'Groonga is fast.'
+              ELSE 'PostgreSQL is a RDBMS.'
+         END
+    FROM generate_series(10001, 13000) AS i;
+
+SELECT pgroonga_set_writable(false);
+
+SELECT count(*), count(DISTINCT id)
+  FROM memos
+ WHERE content &@~ 'groonga';
+
+SELECT pgroonga_set_writable(true);
+
+RESET pgroonga.pending_list_limit;
+
+DROP TABLE memos;
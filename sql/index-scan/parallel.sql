@@ -0,0 +1,28 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos
+  SELECT i,
+         CASE WHEN i % 3 = 0 THEN 'Groonga is fast.'
+              ELSE 'PostgreSQL is a RDBMS.'
+         END
+    FROM generate_series(1, 10000) AS i;
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_index_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+
+SELECT count(*), count(DISTINCT id)
+  FROM memos
+ WHERE content &@~ 'groonga';
+
+DROP TABLE memos;
@@ -0,0 +1,39 @@
+CREATE TABLE items (
+  id integer,
+  price integer,
+  stock integer
+);
+
+INSERT INTO items VALUES (1, 200, 0);
+INSERT INTO items VALUES (2, 100, 5);
+INSERT INTO items VALUES (3, 400, 3);
+INSERT INTO items VALUES (4, 300, 1);
+INSERT INTO items VALUES (5, 150, 2);
+INSERT INTO items VALUES (6, 250, 0);
+
+CREATE INDEX grnindex ON items USING pgroonga (price, stock);
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+EXPLAIN (COSTS OFF)
+SELECT id, price, stock
+  FROM items
+ WHERE price BETWEEN 100 AND 300 AND
+       stock > 0
+ ORDER BY price ASC;
+
+SELECT id, price, stock
+  FROM items
+ WHERE price BETWEEN 100 AND 300 AND
+       stock > 0
+ ORDER BY price ASC;
+
+SELECT id, price, stock
+  FROM items
+ WHERE price BETWEEN 100 AND 300 AND
+       stock > 0
+ ORDER BY price DESC;
+
+DROP TABLE items;
@@ -0,0 +1,35 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos VALUES (1, 'PostgreSQL is a RDBMS.');
+INSERT INTO memos VALUES (2, 'Groonga is fast full text search engine.');
+INSERT INTO memos VALUES (3, 'PGroonga is a PostgreSQL extension that uses Groonga.');
+
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+
+CREATE TABLE keywords (
+  id integer,
+  keyword text
+);
+
+INSERT INTO keywords VALUES (1, 'Groonga');
+INSERT INTO keywords VALUES (2, 'Groonga');
+INSERT INTO keywords VALUES (3, 'RDBMS');
+INSERT INTO keywords VALUES (4, 'Groonga');
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+SET enable_hashjoin = off;
+SET enable_mergejoin = off;
+
+SELECT keywords.id, memos.id
+  FROM keywords
+  JOIN memos ON memos.content &@~ keywords.keyword
+ ORDER BY keywords.id, memos.id;
+
+DROP TABLE keywords;
+DROP TABLE memos;
@@ -0,0 +1,30 @@
+CREATE TABLE fruits (
+  id int,
+  items jsonb
+);
+
+INSERT INTO fruits
+  SELECT i,
+         CASE WHEN i % 2 = 0 THEN '["apple"]'::jsonb
+              ELSE ('["banana", "peach-' || i || '"]')::jsonb
+         END
+    FROM generate_series(1, 3000) AS i;
+
+CREATE INDEX pgroonga_index ON fruits
+  USING pgroonga (items pgroonga_jsonb_ops_v2);
+DELETE FROM fruits WHERE id > 100;
+VACUUM;
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+SELECT count(*)
+  FROM fruits
+ WHERE items &` 'string == "apple"';
+
+SELECT count(*)
+  FROM fruits
+ WHERE items &` 'string == "banana"';
+
+DROP TABLE fruits;
@@ -0,0 +1,31 @@
+CREATE TABLE memos (
+  id integer,
+  content text
+);
+
+INSERT INTO memos
+  SELECT i,
+         CASE i % 3
+           WHEN 0 THEN 'Groonga is fast full text search engine: ' || i
+           ELSE 'PostgreSQL is a RDBMS: ' || i
+         END
+    FROM generate_series(1, 10000) AS i;
+
+SET pgroonga.thread_limit = 4;
+CREATE INDEX grnindex ON memos
+ USING pgroonga (content pgroonga_text_full_text_search_ops_v2);
+SET pgroonga.thread_limit = default;
+
+SET enable_seqscan = off;
+SET enable_indexscan = on;
+SET enable_bitmapscan = off;
+
+SELECT count(*)
+  FROM memos
+ WHERE content &@ 'Groonga';
+
+SELECT id, content
+  FROM memos
+ WHERE content &@ '9999';
+
+DROP TABLE memos;
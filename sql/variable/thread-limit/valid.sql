@@ -0,0 +1,8 @@
+-- To load PGroonga
+SELECT pgroonga_command('status')::json->0->0;
+
+SHOW pgroonga.thread_limit;
+SET pgroonga.thread_limit = 4;
+SHOW pgroonga.thread_limit;
+SET pgroonga.thread_limit = default;
+SHOW pgroonga.thread_limit;
@@ -1,7 +1,9 @@
 #include "pgroonga.h"
 
 #include "pgrn-auto-close.h"
+#include "pgrn-condition-cache.h"
 #include "pgrn-global.h"
+#include "pgrn-object-cache.h"
 
 static grn_ctx *ctx = &PGrnContext;
 static grn_hash *usingIndexes = NULL;
@@ -40,12 +42,16 @@ PGrnAutoCloseCloseUnusedObjects(Oid nodeID)
 		PGrnJSONValuesTableNamePrefix "%u_",
 		PGrnJSONPathsTableNamePrefix "%u_",
 		PGrnBuildingSourcesTableNamePrefix "%u",
+		PGrnPendingSourcesTableNamePrefix "%u",
 		PGrnSourcesTableNamePrefix "%u",
 	};
 	size_t i;
 	const size_t n_prefixes = sizeof(prefixes) / sizeof(*prefixes);
 	grn_obj *db;
 
+	PGrnConditionCacheRemoveByNodeID(nodeID);
+	PGrnObjectCacheRemoveByNodeID(nodeID);
+
 	db = grn_ctx_db(ctx);
 	for (i = 0; i < n_prefixes; i++)
 	{
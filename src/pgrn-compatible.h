@@ -32,6 +32,8 @@ typedef char *PGrnStringOptionValue;
 #	define PGRN_SUPPORT_INDEX_CLAUSE
 #	define PGRN_SUPPORT_TABLEAM
 #	define PGRN_HAVE_OPTIMIZER_H
+#	define PGRN_SUPPORT_PARALLEL_BUILD
+#	define PGRN_SUPPORT_PROGRESS
 #endif
 
 #if PG_VERSION_NUM >= 130000
@@ -39,6 +41,7 @@ typedef char *PGrnStringOptionValue;
 #	define PGRN_HAVE_BUILD_RELOPTIONS
 #	define PGRN_HAVE_JSONB_DATETIME
 #	define PGRN_INDEX_BUILD_CALLBACK_USE_ITEM_POINTER
+#	define PGRN_HAVE_MEMORY_CONTEXT_MEM_ALLOCATED
 #endif
 
 #ifndef ERRCODE_SYSTEM_ERROR
@@ -70,7 +73,7 @@ typedef char *PGrnStringOptionValue;
 						   (index),					\
 						   (indexInfo),				\
 						   (allowSync),				\
-						   false,					\
+						   true,					\
 						   (callback),				\
 						   (callbackState),			\
 						   NULL)
@@ -191,6 +194,14 @@ typedef char *PGrnStringOptionValue;
 #	define PG_RETURN_JSONB_P(x) PG_RETURN_JSONB(x)
 #endif
 
+#if PG_VERSION_NUM >= 120000
+#	define pgrn_pglz_decompress(source, sourceSize, dest, rawSize)	\
+	pglz_decompress((source), (sourceSize), (dest), (rawSize), true)
+#else
+#	define pgrn_pglz_decompress(source, sourceSize, dest, rawSize)	\
+	pglz_decompress((source), (sourceSize), (dest), (rawSize))
+#endif
+
 #if PG_VERSION_NUM >= 120000
 #	define PGRN_HAVE_TUPLE_TABLE_SLOT_TABLE_OID
 #endif
@@ -209,6 +220,7 @@ typedef char *PGrnStringOptionValue;
 
 #if PG_VERSION_NUM >= 110000
 #	define PGRN_INDEX_AM_ROUTINE_HAVE_AM_CAN_INCLUDE
+#	define PGRN_HAVE_TBM_CALCULATE_ENTRIES
 #endif
 
 #if PG_VERSION_NUM >= 120000
@@ -0,0 +1,174 @@
+#include "pgroonga.h"
+
+#include "pgrn-condition-cache.h"
+#include "pgrn-global.h"
+
+#include <funcapi.h>
+#include <lib/ilist.h>
+#include <utils/memutils.h>
+
+#include <xxhash.h>
+
+/*
+ * Backend local LRU cache of compiled search conditions. Keys are
+ * serialized by the caller and must contain everything that affects
+ * the compiled condition. Entries are removed when objects for the
+ * relation file node are closed.
+ */
+
+#define PGRN_CONDITION_CACHE_MAX_N_ENTRIES 128
+
+typedef struct PGrnConditionCacheEntry
+{
+	dlist_node node;
+	Oid nodeID;
+	uint64_t hash;
+	size_t keySize;
+	void *value;
+	char key[FLEXIBLE_ARRAY_MEMBER];
+} PGrnConditionCacheEntry;
+
+static grn_ctx *ctx = &PGrnContext;
+static dlist_head entries = DLIST_STATIC_INIT(entries);
+static int nEntries = 0;
+static uint64 nHits = 0;
+static uint64 nMisses = 0;
+static PGrnConditionCacheFreeFunction valueFree = NULL;
+
+PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_condition_cache_status);
+
+void
+PGrnInitializeConditionCache(PGrnConditionCacheFreeFunction freeFunction)
+{
+	dlist_init(&entries);
+	nEntries = 0;
+	nHits = 0;
+	nMisses = 0;
+	valueFree = freeFunction;
+}
+
+static void
+PGrnConditionCacheEntryFree(PGrnConditionCacheEntry *entry)
+{
+	dlist_delete(&(entry->node));
+	nEntries--;
+	if (valueFree)
+		valueFree(entry->value);
+	pfree(entry);
+}
+
+void
+PGrnFinalizeConditionCache(void)
+{
+	dlist_mutable_iter iter;
+
+	dlist_foreach_modify(iter, &entries)
+	{
+		PGrnConditionCacheEntry *entry =
+			dlist_container(PGrnConditionCacheEntry, node, iter.cur);
+		PGrnConditionCacheEntryFree(entry);
+	}
+	valueFree = NULL;
+}
+
+void *
+PGrnConditionCacheGet(Oid nodeID, grn_obj *key)
+{
+	const char *tag = "pgroonga: [condition-cache][get]";
+	uint64_t hash = XXH64(GRN_BULK_HEAD(key), GRN_BULK_VSIZE(key), 0);
+	dlist_iter iter;
+
+	dlist_foreach(iter, &entries)
+	{
+		PGrnConditionCacheEntry *entry =
+			dlist_container(PGrnConditionCacheEntry, node, iter.cur);
+
+		if (entry->nodeID != nodeID)
+			continue;
+		if (entry->hash != hash)
+			continue;
+		if (entry->keySize != GRN_BULK_VSIZE(key))
+			continue;
+		if (memcmp(entry->key, GRN_BULK_HEAD(key), entry->keySize) != 0)
+			continue;
+
+		dlist_move_head(&entries, &(entry->node));
+		nHits++;
+		GRN_LOG(ctx, GRN_LOG_DEBUG, "%s[hit] <%u>", tag, nodeID);
+		return entry->value;
+	}
+
+	nMisses++;
+	GRN_LOG(ctx, GRN_LOG_DEBUG, "%s[miss] <%u>", tag, nodeID);
+	return NULL;
+}
+
+void
+PGrnConditionCacheAdd(Oid nodeID, grn_obj *key, void *value)
+{
+	size_t keySize = GRN_BULK_VSIZE(key);
+	PGrnConditionCacheEntry *entry;
+
+	if (nEntries >= PGRN_CONDITION_CACHE_MAX_N_ENTRIES)
+	{
+		PGrnConditionCacheEntry *oldestEntry =
+			dlist_container(PGrnConditionCacheEntry,
+							node,
+							dlist_tail_node(&entries));
+		PGrnConditionCacheEntryFree(oldestEntry);
+	}
+
+	entry = MemoryContextAlloc(TopMemoryContext,
+							   offsetof(PGrnConditionCacheEntry, key) +
+							   keySize);
+	entry->nodeID = nodeID;
+	entry->hash = XXH64(GRN_BULK_HEAD(key), keySize, 0);
+	entry->keySize = keySize;
+	entry->value = value;
+	memcpy(entry->key, GRN_BULK_HEAD(key), keySize);
+	dlist_push_head(&entries, &(entry->node));
+	nEntries++;
+}
+
+void
+PGrnConditionCacheRemoveByNodeID(Oid nodeID)
+{
+	dlist_mutable_iter iter;
+
+	dlist_foreach_modify(iter, &entries)
+	{
+		PGrnConditionCacheEntry *entry =
+			dlist_container(PGrnConditionCacheEntry, node, iter.cur);
+		if (entry->nodeID != nodeID)
+			continue;
+		PGrnConditionCacheEntryFree(entry);
+	}
+}
+
+/**
+ * pgroonga_condition_cache_status(OUT hits bigint,
+ *                                 OUT misses bigint,
+ *                                 OUT n_entries integer) : record
+ */
+Datum
+pgroonga_condition_cache_status(PG_FUNCTION_ARGS)
+{
+	TupleDesc desc;
+	Datum values[3];
+	bool nulls[3] = {false, false, false};
+
+	if (get_call_result_type(fcinfo, NULL, &desc) != TYPEFUNC_COMPOSITE)
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("pgroonga: [condition-cache][status] "
+						"must be called as a function returning record")));
+	}
+	desc = BlessTupleDesc(desc);
+
+	values[0] = Int64GetDatum(nHits);
+	values[1] = Int64GetDatum(nMisses);
+	values[2] = Int32GetDatum(nEntries);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(desc, values, nulls)));
+}
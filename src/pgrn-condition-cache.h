@@ -0,0 +1,14 @@
+#pragma once
+
+#include <postgres.h>
+
+#include <groonga.h>
+
+typedef void (*PGrnConditionCacheFreeFunction)(void *value);
+
+void PGrnInitializeConditionCache(PGrnConditionCacheFreeFunction freeFunction);
+void PGrnFinalizeConditionCache(void);
+
+void *PGrnConditionCacheGet(Oid nodeID, grn_obj *key);
+void PGrnConditionCacheAdd(Oid nodeID, grn_obj *key, void *value);
+void PGrnConditionCacheRemoveByNodeID(Oid nodeID);
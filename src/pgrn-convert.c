@@ -175,3 +175,23 @@ PGrnConvertFromData(Datum datum, Oid typeID, grn_obj *buffer)
 		break;
 	}
 }
+
+/*
+ * Returns whether PGrnConvertFromData() can refer the datum instead of
+ * copying it. The buffer must be initialized with
+ * GRN_OBJ_DO_SHALLOW_COPY and it must not be used after the datum is
+ * freed.
+ */
+bool
+PGrnConvertFromDataCanRefer(Oid typeID)
+{
+	switch (typeID)
+	{
+	case TEXTOID:
+	case XMLOID:
+	case VARCHAROID:
+		return true;
+	default:
+		return false;
+	}
+}
@@ -7,3 +7,4 @@
 #define VARCHARARRAYOID 1015
 
 void PGrnConvertFromData(Datum datum, Oid typeID, grn_obj *buffer);
+bool PGrnConvertFromDataCanRefer(Oid typeID);
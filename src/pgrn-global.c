@@ -5,6 +5,9 @@
 grn_ctx PGrnContext;
 struct PGrnBuffers PGrnBuffers;
 int PGrnMatchEscalationThreshold = 0;
+bool PGrnEnableHeapOrderScan = false;
+int PGrnThreadLimit = 1;
+int PGrnPendingListLimit = 1000;
 
 static grn_ctx *ctx = &PGrnContext;
 
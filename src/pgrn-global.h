@@ -40,6 +40,9 @@ struct PGrnBuffers
 extern grn_ctx PGrnContext;
 extern struct PGrnBuffers PGrnBuffers;
 extern int PGrnMatchEscalationThreshold;
+extern bool PGrnEnableHeapOrderScan;
+extern int PGrnThreadLimit;
+extern int PGrnPendingListLimit;
 
 void PGrnInitializeBuffers(void);
 void PGrnFinalizeBuffers(void);
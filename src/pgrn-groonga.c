@@ -4,6 +4,7 @@
 #include "pgrn-convert.h"
 #include "pgrn-global.h"
 #include "pgrn-groonga.h"
+#include "pgrn-object-cache.h"
 #include "pgrn-pg.h"
 #include "pgrn-row-level-security.h"
 #include "pgrn-wal.h"
@@ -11,6 +12,7 @@
 #include <catalog/catalog.h>
 #include <catalog/pg_type.h>
 #include <miscadmin.h>
+#include <utils/memutils.h>
 
 bool PGrnIsLZ4Available;
 bool PGrnIsZlibAvailable;
@@ -260,48 +262,134 @@ PGrnLookupColumnWithSize(grn_obj *table,
 grn_obj *
 PGrnLookupSourcesTable(Relation index, int errorLevel)
 {
+	PGrnObjectCacheEntry *entry = PGrnObjectCacheGet(index);
 	char name[GRN_TABLE_MAX_KEY_SIZE];
+	grn_obj *table;
+
+	if (entry && entry->sourcesTable)
+		return entry->sourcesTable;
 
 	snprintf(name, sizeof(name),
 			 PGrnSourcesTableNameFormat,
 			 index->rd_node.relNode);
-	return PGrnLookup(name, errorLevel);
+	table = PGrnLookup(name, errorLevel);
+	if (entry)
+		entry->sourcesTable = table;
+	return table;
 }
 
 grn_obj *
 PGrnLookupSourcesCtidColumn(Relation index, int errorLevel)
 {
+	PGrnObjectCacheEntry *entry = PGrnObjectCacheGet(index);
 	char name[GRN_TABLE_MAX_KEY_SIZE];
+	grn_obj *column;
+
+	if (entry && entry->sourcesCtidColumn)
+		return entry->sourcesCtidColumn;
 
 	snprintf(name, sizeof(name),
 			 PGrnSourcesTableNameFormat "." PGrnSourcesCtidColumnName,
 			 index->rd_node.relNode);
-	return PGrnLookup(name, errorLevel);
+	column = PGrnLookup(name, errorLevel);
+	if (entry)
+		entry->sourcesCtidColumn = column;
+	return column;
+}
+
+/*
+ * Sets data columns of the sources table for all attributes to
+ * columns. columns must have RelationGetDescr(index)->natts
+ * elements. Names are allocated in CurrentMemoryContext. So columns
+ * are still valid after the cache is invalidated.
+ */
+void
+PGrnLookupSourcesColumns(Relation index, PGrnObjectCacheColumn columns)
+{
+	TupleDesc desc = RelationGetDescr(index);
+	PGrnObjectCacheEntry *entry = PGrnObjectCacheGet(index);
+	grn_obj *sourcesTable;
+	MemoryContext oldMemoryContext;
+	unsigned int i;
+
+	if (entry && entry->sourcesColumns)
+	{
+		for (i = 0; i < desc->natts; i++)
+		{
+			columns[i] = entry->sourcesColumns[i];
+			columns[i].name = pnstrdup(columns[i].name, columns[i].nameSize);
+		}
+		return;
+	}
+
+	sourcesTable = PGrnLookupSourcesTable(index, ERROR);
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute attribute = TupleDescAttr(desc, i);
+		PGrnObjectCacheColumnInit(&(columns[i]),
+								  PGrnLookupColumn(sourcesTable,
+												   attribute->attname.data,
+												   ERROR));
+	}
+
+	if (!entry)
+		return;
+
+	oldMemoryContext = MemoryContextSwitchTo(TopMemoryContext);
+	entry->sourcesColumns =
+		palloc(sizeof(PGrnObjectCacheColumnData) * entry->nAttributes);
+	for (i = 0; i < entry->nAttributes; i++)
+	{
+		entry->sourcesColumns[i] = columns[i];
+		entry->sourcesColumns[i].name = pnstrdup(columns[i].name,
+												 columns[i].nameSize);
+	}
+	MemoryContextSwitchTo(oldMemoryContext);
 }
 
 grn_obj *
 PGrnLookupLexicon(Relation index, unsigned int nthAttribute, int errorLevel)
 {
+	PGrnObjectCacheEntry *entry = PGrnObjectCacheGet(index);
 	char name[GRN_TABLE_MAX_KEY_SIZE];
+	grn_obj *lexicon;
+
+	if (entry && nthAttribute >= entry->nAttributes)
+		entry = NULL;
+	if (entry && entry->lexicons[nthAttribute])
+		return entry->lexicons[nthAttribute];
 
 	snprintf(name, sizeof(name),
 			 PGrnLexiconNameFormat,
 			 index->rd_node.relNode,
 			 nthAttribute);
-	return PGrnLookup(name, errorLevel);
+	lexicon = PGrnLookup(name, errorLevel);
+	if (entry)
+		entry->lexicons[nthAttribute] = lexicon;
+	return lexicon;
 }
 
 grn_obj *
 PGrnLookupIndexColumn(Relation index, unsigned int nthAttribute, int errorLevel)
 {
+	PGrnObjectCacheEntry *entry = PGrnObjectCacheGet(index);
 	char name[GRN_TABLE_MAX_KEY_SIZE];
+	grn_obj *indexColumn;
+
+	if (entry && nthAttribute >= entry->nAttributes)
+		entry = NULL;
+	if (entry && entry->indexColumns[nthAttribute])
+		return entry->indexColumns[nthAttribute];
 
 	snprintf(name, sizeof(name),
 			 PGrnLexiconNameFormat ".%s",
 			 index->rd_node.relNode,
 			 nthAttribute,
 			 PGrnIndexColumnName);
-	return PGrnLookup(name, errorLevel);
+	indexColumn = PGrnLookup(name, errorLevel);
+	if (entry)
+		entry->indexColumns[nthAttribute] = indexColumn;
+	return indexColumn;
 }
 
 void
@@ -549,6 +637,7 @@ PGrnRemoveObjectWithSize(const char *name,
 	grn_obj *object;
 
 	object = PGrnLookupWithSize(name, nameSize, ERROR);
+	PGrnObjectCacheClear();
 	grn_obj_remove(ctx, object);
 	PGrnCheck("failed to remove: <%.*s>",
 			  (int)nameSize, name);
@@ -594,6 +683,7 @@ PGrnRemoveColumns(grn_obj *table)
 				  PGrnInspectName(table));
 	}
 
+	PGrnObjectCacheClear();
 	GRN_HASH_EACH_BEGIN(ctx, columns, cursor, id) {
 		grn_id *columnID;
 		grn_obj *column;
@@ -5,6 +5,8 @@
 
 #include <groonga.h>
 
+#include "pgrn-object-cache.h"
+
 #ifndef GRN_VERSION_OR_LATER
 #	define GRN_VERSION_OR_LATER(major, minor, micro) 0
 #endif
@@ -41,6 +43,7 @@ grn_obj *PGrnLookupColumnWithSize(grn_obj *table,
 								  int errorLevel);
 grn_obj *PGrnLookupSourcesTable(Relation index, int errorLevel);
 grn_obj *PGrnLookupSourcesCtidColumn(Relation index, int errorLevel);
+void PGrnLookupSourcesColumns(Relation index, PGrnObjectCacheColumn columns);
 grn_obj *PGrnLookupLexicon(Relation index,
 						   unsigned int nthAttribute,
 						   int errorLevel);
@@ -15,10 +15,62 @@ static struct PGrnBuffers *buffers = &PGrnBuffers;
 #define MAX_RECORD_SIZE_COLUMN_NAME "max_record_size"
 #define WAL_APPLIED_POSITION_COLUMN_NAME "wal_applied_position"
 
+/*
+ * IDs of the table and columns. Looking up an object by ID is much
+ * faster than looking it up by name. The WAL applied position is
+ * updated for each applied WAL record. An ID may be reused by another
+ * object after the object is removed. So the name of the object found
+ * by ID is checked and the object is looked up by name again when it
+ * doesn't match.
+ */
+static grn_id tableID = GRN_ID_NIL;
+static grn_id maxRecordSizeColumnID = GRN_ID_NIL;
+static grn_id walAppliedPositionColumnID = GRN_ID_NIL;
+
+static bool
+PGrnIndexStatusIsNamed(grn_obj *object, const char *name, size_t nameSize)
+{
+	char objectName[GRN_TABLE_MAX_KEY_SIZE];
+	int objectNameSize;
+
+	objectNameSize = grn_obj_name(ctx, object, objectName, sizeof(objectName));
+	return (size_t) objectNameSize == nameSize &&
+		memcmp(objectName, name, nameSize) == 0;
+}
+
+static grn_obj *
+PGrnIndexStatusLookup(grn_id *id, const char *name, size_t nameSize)
+{
+	grn_obj *object = NULL;
+
+	if (*id != GRN_ID_NIL)
+	{
+		object = grn_ctx_at(ctx, *id);
+		if (object && !PGrnIndexStatusIsNamed(object, name, nameSize))
+			object = NULL;
+	}
+	if (!object)
+	{
+		object = PGrnLookupWithSize(name, nameSize, ERROR);
+		*id = grn_obj_id(ctx, object);
+	}
+	return object;
+}
+
+#define PGrnIndexStatusLookupTable()			\
+	PGrnIndexStatusLookup(&tableID,				\
+						  TABLE_NAME,			\
+						  TABLE_NAME_SIZE)
+#define PGrnIndexStatusLookupColumn(id, name)				\
+	PGrnIndexStatusLookup((id),								\
+						  TABLE_NAME "." name,				\
+						  strlen(TABLE_NAME "." name))
+
 void
 PGrnInitializeIndexStatus(void)
 {
 	grn_obj *table;
+	grn_obj *column;
 
 	table = grn_ctx_get(ctx,
 						TABLE_NAME,
@@ -35,23 +87,31 @@ PGrnInitializeIndexStatus(void)
 										NULL);
 	}
 
-	if (!grn_ctx_get(ctx, TABLE_NAME "." MAX_RECORD_SIZE_COLUMN_NAME, -1))
+	tableID = grn_obj_id(ctx, table);
+
+	column = grn_ctx_get(ctx, TABLE_NAME "." MAX_RECORD_SIZE_COLUMN_NAME, -1);
+	if (!column)
 	{
-		PGrnCreateColumn(NULL,
-						 table,
-						 MAX_RECORD_SIZE_COLUMN_NAME,
-						 GRN_OBJ_COLUMN_SCALAR,
-						 grn_ctx_at(ctx, GRN_DB_UINT32));
+		column = PGrnCreateColumn(NULL,
+								  table,
+								  MAX_RECORD_SIZE_COLUMN_NAME,
+								  GRN_OBJ_COLUMN_SCALAR,
+								  grn_ctx_at(ctx, GRN_DB_UINT32));
 	}
+	maxRecordSizeColumnID = grn_obj_id(ctx, column);
 
-	if (!grn_ctx_get(ctx, TABLE_NAME "." WAL_APPLIED_POSITION_COLUMN_NAME, -1))
+	column = grn_ctx_get(ctx,
+						 TABLE_NAME "." WAL_APPLIED_POSITION_COLUMN_NAME,
+						 -1);
+	if (!column)
 	{
-		PGrnCreateColumn(NULL,
-						 table,
-						 WAL_APPLIED_POSITION_COLUMN_NAME,
-						 GRN_OBJ_COLUMN_SCALAR,
-						 grn_ctx_at(ctx, GRN_DB_UINT64));
+		column = PGrnCreateColumn(NULL,
+								  table,
+								  WAL_APPLIED_POSITION_COLUMN_NAME,
+								  GRN_OBJ_COLUMN_SCALAR,
+								  grn_ctx_at(ctx, GRN_DB_UINT64));
 	}
+	walAppliedPositionColumnID = grn_obj_id(ctx, column);
 }
 
 void
@@ -62,7 +122,7 @@ PGrnIndexStatusDeleteRaw(Oid indexFileNodeID)
 	size_t keySize;
 	grn_id id;
 
-	table = PGrnLookupWithSize(TABLE_NAME, TABLE_NAME_SIZE, ERROR);
+	table = PGrnIndexStatusLookupTable();
 	key = &indexFileNodeID;
 	keySize = sizeof(uint32_t);
 
@@ -92,7 +152,7 @@ PGrnIndexStatusGetRecordIDWithWAL(Relation index,
 	size_t keySize;
 	grn_id id;
 
-	table = PGrnLookupWithSize(TABLE_NAME, TABLE_NAME_SIZE, ERROR);
+	table = PGrnIndexStatusLookupTable();
 	key = &(index->rd_node.relNode);
 	keySize = sizeof(uint32_t);
 	id = grn_table_add(ctx, table, key, keySize, NULL);
@@ -119,8 +179,8 @@ PGrnIndexStatusGetMaxRecordSize(Relation index)
 	grn_obj *maxRecordSize = &(buffers->maxRecordSize);
 
 	id = PGrnIndexStatusGetRecordID(index);
-	column = PGrnLookup(TABLE_NAME "." MAX_RECORD_SIZE_COLUMN_NAME,
-						ERROR);
+	column = PGrnIndexStatusLookupColumn(&maxRecordSizeColumnID,
+										 MAX_RECORD_SIZE_COLUMN_NAME);
 	GRN_BULK_REWIND(maxRecordSize);
 	grn_obj_get_value(ctx, column, id, maxRecordSize);
 	return GRN_UINT32_VALUE(maxRecordSize);
@@ -136,8 +196,8 @@ PGrnIndexStatusSetMaxRecordSize(Relation index, uint32_t size)
 	size_t nColumns = 2;
 
 	id = PGrnIndexStatusGetRecordIDWithWAL(index, &walData, nColumns);
-	column = PGrnLookup(TABLE_NAME "." MAX_RECORD_SIZE_COLUMN_NAME,
-						ERROR);
+	column = PGrnIndexStatusLookupColumn(&maxRecordSizeColumnID,
+										 MAX_RECORD_SIZE_COLUMN_NAME);
 	GRN_UINT32_SET(ctx, maxRecordSize, size);
 	grn_obj_set_value(ctx, column, id, maxRecordSize, GRN_OBJ_SET);
 	grn_db_touch(ctx, grn_ctx_db(ctx));
@@ -157,8 +217,8 @@ PGrnIndexStatusGetWALAppliedPosition(Relation index,
 	uint64_t positionRaw;
 
 	id = PGrnIndexStatusGetRecordID(index);
-	column = PGrnLookup(TABLE_NAME "." WAL_APPLIED_POSITION_COLUMN_NAME,
-						ERROR);
+	column = PGrnIndexStatusLookupColumn(&walAppliedPositionColumnID,
+										 WAL_APPLIED_POSITION_COLUMN_NAME);
 	GRN_BULK_REWIND(position);
 	grn_obj_get_value(ctx, column, id, position);
 	positionRaw = GRN_UINT64_VALUE(position);
@@ -177,8 +237,8 @@ PGrnIndexStatusSetWALAppliedPosition(Relation index,
 	uint64_t positionRaw;
 
 	id = PGrnIndexStatusGetRecordID(index);
-	column = PGrnLookup(TABLE_NAME "." WAL_APPLIED_POSITION_COLUMN_NAME,
-						ERROR);
+	column = PGrnIndexStatusLookupColumn(&walAppliedPositionColumnID,
+										 WAL_APPLIED_POSITION_COLUMN_NAME);
 	positionRaw = (((uint64_t)block) << 32) + (uint64_t)offset;
 	GRN_UINT64_SET(ctx, position, positionRaw);
 	grn_obj_set_value(ctx, column, id, position, GRN_OBJ_SET);
@@ -1898,69 +1898,32 @@ PGrnJSONBBuildSearchCondition(PGrnSearchData *data,
 	return true;
 }
 
-static void
-PGrnJSONValuesUpdateDeletedID(grn_obj *jsonValuesTable,
-							  grn_obj *values,
-							  grn_obj *valueMin,
-							  grn_obj *valueMax)
-{
-	unsigned int i, n;
-
-	n = GRN_BULK_VSIZE(values) / sizeof(grn_id);
-	for (i = 0; i < n; i++)
-	{
-		grn_id valueID = GRN_RECORD_VALUE_AT(values, i);
-
-		if (GRN_RECORD_VALUE(valueMin) == GRN_ID_NIL ||
-			GRN_RECORD_VALUE(valueMin) > valueID)
-		{
-			GRN_RECORD_SET(ctx, valueMin, valueID);
-		}
-
-		if (GRN_RECORD_VALUE(valueMax) == GRN_ID_NIL ||
-			GRN_RECORD_VALUE(valueMax) < valueID)
-		{
-			GRN_RECORD_SET(ctx, valueMax, valueID);
-		}
-	}
-}
-
 static void
 PGrnJSONValuesDeleteBulk(PGrnJSONBBulkDeleteData *data)
 {
+	const char *tag = "[jsonb][bulk-delete][values]";
 	grn_obj *jsonValuesTable = data->valuesTable;
 	grn_obj *jsonValuesIndexColumn = data->valuesIndexColumn;
-	grn_obj *valueMin = &(data->valueMin);
-	grn_obj *valueMax = &(data->valueMax);
-	char minKey[GRN_TABLE_MAX_KEY_SIZE];
-	char maxKey[GRN_TABLE_MAX_KEY_SIZE];
-	unsigned int minKeySize;
-	unsigned int maxKeySize;
 	grn_table_cursor *tableCursor;
-	grn_id valueID;
 
-	minKeySize = grn_table_get_key(ctx,
-								   jsonValuesTable,
-								   GRN_RECORD_VALUE(valueMin),
-								   minKey,
-								   sizeof(minKey));
-	maxKeySize = grn_table_get_key(ctx,
-								   jsonValuesTable,
-								   GRN_RECORD_VALUE(valueMax),
-								   maxKey,
-								   sizeof(maxKey));
-	tableCursor = grn_table_cursor_open(ctx, jsonValuesTable,
-										minKey, minKeySize,
-										maxKey, maxKeySize,
-										0, -1, 0);
-	if (!tableCursor)
+	if (grn_table_size(ctx, data->deletedValues) == 0)
 		return;
 
-	while ((valueID = grn_table_cursor_next(ctx, tableCursor)) != GRN_ID_NIL)
+	tableCursor = grn_table_cursor_open(ctx, data->deletedValues,
+										NULL, 0, NULL, 0,
+										0, -1, 0);
+	PGrnCheck("%s failed to open cursor", tag);
+
+	while (grn_table_cursor_next(ctx, tableCursor) != GRN_ID_NIL)
 	{
+		void *deletedValueKey;
+		grn_id valueID;
 		grn_ii_cursor *iiCursor;
 		bool haveReference = false;
 
+		grn_table_cursor_get_key(ctx, tableCursor, &deletedValueKey);
+		valueID = *((grn_id *) deletedValueKey);
+
 		iiCursor = grn_ii_cursor_open(ctx,
 									  (grn_ii *)jsonValuesIndexColumn,
 									  valueID,
@@ -1977,23 +1940,33 @@ PGrnJSONValuesDeleteBulk(PGrnJSONBBulkDeleteData *data)
 
 		if (!haveReference)
 		{
-			void *key;
+			char key[GRN_TABLE_MAX_KEY_SIZE];
 			int keySize;
-			keySize = grn_table_cursor_get_key(ctx, tableCursor, &key);
+			keySize = grn_table_get_key(ctx,
+										jsonValuesTable,
+										valueID,
+										key,
+										sizeof(key));
+			if (keySize == 0)
+				continue;
 			PGrnWALDelete(data->index,
 						  jsonValuesTable,
 						  key,
 						  keySize);
-			grn_table_cursor_delete(ctx, tableCursor);
+			grn_table_delete_by_id(ctx, jsonValuesTable, valueID);
 		}
 	}
 
 	grn_table_cursor_close(ctx, tableCursor);
+
+	grn_table_truncate(ctx, data->deletedValues);
+	PGrnCheck("%s failed to clear deleted values", tag);
 }
 
 void
 PGrnJSONBBulkDeleteInit(PGrnJSONBBulkDeleteData *data)
 {
+	const char *tag = "[jsonb][bulk-delete][init]";
 	Relation index = data->index;
 	unsigned int nthAttribute = 0;
 	TupleDesc desc;
@@ -2018,19 +1991,20 @@ PGrnJSONBBulkDeleteInit(PGrnJSONBBulkDeleteData *data)
 	data->valuesIndexColumn = PGrnLookupColumn(data->valuesTable,
 											   PGrnIndexColumnName,
 											   ERROR);
+	data->deletedValues = grn_table_create(ctx, NULL, 0, NULL,
+										   GRN_TABLE_HASH_KEY,
+										   data->valuesTable, NULL);
+	PGrnCheck("%s failed to create deleted values table", tag);
 
 	valuesTableID = grn_obj_id(ctx, data->valuesTable);
-	GRN_RECORD_INIT(&(data->values),   0, valuesTableID);
-	GRN_RECORD_INIT(&(data->valueMin), 0, valuesTableID);
-	GRN_RECORD_INIT(&(data->valueMax), 0, valuesTableID);
-
-	GRN_RECORD_SET(ctx, &(data->valueMin), GRN_ID_NIL);
-	GRN_RECORD_SET(ctx, &(data->valueMax), GRN_ID_NIL);
+	GRN_RECORD_INIT(&(data->values), 0, valuesTableID);
 }
 
 void
 PGrnJSONBBulkDeleteRecord(PGrnJSONBBulkDeleteData *data)
 {
+	unsigned int i, n;
+
 	if (!data->isJSONBAttribute)
 		return;
 
@@ -2042,10 +2016,33 @@ PGrnJSONBBulkDeleteRecord(PGrnJSONBBulkDeleteData *data)
 					  data->sourcesValuesColumn,
 					  data->id,
 					  &(data->values));
-	PGrnJSONValuesUpdateDeletedID(data->valuesTable,
-								  &(data->values),
-								  &(data->valueMin),
-								  &(data->valueMax));
+	n = GRN_BULK_VSIZE(&(data->values)) / sizeof(grn_id);
+	for (i = 0; i < n; i++)
+	{
+		grn_id valueID = GRN_RECORD_VALUE_AT(&(data->values), i);
+		grn_table_add(ctx,
+					  data->deletedValues,
+					  &valueID,
+					  sizeof(grn_id),
+					  NULL);
+	}
+}
+
+/*
+ * Values that aren't referenced from any record are deleted. This
+ * must be called after the records passed to
+ * PGrnJSONBBulkDeleteRecord() are deleted.
+ */
+void
+PGrnJSONBBulkDeleteFlush(PGrnJSONBBulkDeleteData *data)
+{
+	if (!data->isJSONBAttribute)
+		return;
+
+	if (data->isForFullTextSearchOnly)
+		return;
+
+	PGrnJSONValuesDeleteBulk(data);
 }
 
 void
@@ -2060,6 +2057,7 @@ PGrnJSONBBulkDeleteFin(PGrnJSONBBulkDeleteData *data)
 	PGrnJSONValuesDeleteBulk(data);
 
 	GRN_OBJ_FIN(ctx, &(data->values));
+	grn_obj_close(ctx, data->deletedValues);
 	grn_obj_unlink(ctx, data->sourcesValuesColumn);
 	grn_obj_unlink(ctx, data->valuesIndexColumn);
 	grn_obj_unlink(ctx, data->valuesTable);
@@ -70,14 +70,14 @@ typedef struct
 	grn_obj *sourcesValuesColumn;
 	grn_obj *valuesTable;
 	grn_obj *valuesIndexColumn;
+	grn_obj *deletedValues;
 	grn_obj values;
-	grn_obj valueMin;
-	grn_obj valueMax;
 	grn_id id;
 } PGrnJSONBBulkDeleteData;
 
 void PGrnJSONBBulkDeleteInit(PGrnJSONBBulkDeleteData *data);
 void PGrnJSONBBulkDeleteRecord(PGrnJSONBBulkDeleteData *data);
+void PGrnJSONBBulkDeleteFlush(PGrnJSONBBulkDeleteData *data);
 void PGrnJSONBBulkDeleteFin(PGrnJSONBBulkDeleteData *data);
 
 void PGrnJSONBRemoveUnusedTables(Oid relationFileNodeID);
@@ -0,0 +1,193 @@
+#include "pgroonga.h"
+
+#include "pgrn-global.h"
+#include "pgrn-object-cache.h"
+
+#include <utils/hsearch.h>
+#include <utils/inval.h>
+#include <utils/memutils.h>
+
+/*
+ * Backend local cache of Groonga objects for each index. Looking up
+ * an object by name is slow because it formats the name and searches
+ * it in the database. Entries are keyed by index OID and they are
+ * invalidated when the relation cache entry of the index is
+ * invalidated, the relation file node is changed by REINDEX or
+ * objects for the relation file node are closed.
+ */
+
+static grn_ctx *ctx = &PGrnContext;
+static HTAB *entries = NULL;
+static bool callbackRegistered = false;
+
+static void
+PGrnObjectCacheEntryFin(PGrnObjectCacheEntry *entry)
+{
+	if (entry->sourcesColumns)
+	{
+		unsigned int i;
+		for (i = 0; i < entry->nAttributes; i++)
+		{
+			if (entry->sourcesColumns[i].name)
+				pfree(entry->sourcesColumns[i].name);
+		}
+		pfree(entry->sourcesColumns);
+	}
+	pfree(entry->lexicons);
+	pfree(entry->indexColumns);
+}
+
+static void
+PGrnObjectCacheRemove(PGrnObjectCacheEntry *entry)
+{
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: [object-cache][remove] <%u>(%u)",
+			entry->indexID,
+			entry->nodeID);
+	PGrnObjectCacheEntryFin(entry);
+	hash_search(entries, &(entry->indexID), HASH_REMOVE, NULL);
+}
+
+static void
+PGrnObjectCacheRemoveAll(void)
+{
+	HASH_SEQ_STATUS status;
+	PGrnObjectCacheEntry *entry;
+
+	hash_seq_init(&status, entries);
+	while ((entry = hash_seq_search(&status)))
+	{
+		PGrnObjectCacheRemove(entry);
+	}
+}
+
+static void
+PGrnObjectCacheInvalidateRelation(Datum arg, Oid relationID)
+{
+	PGrnObjectCacheEntry *entry;
+
+	if (!entries)
+		return;
+
+	if (!OidIsValid(relationID))
+	{
+		PGrnObjectCacheRemoveAll();
+		return;
+	}
+
+	entry = hash_search(entries, &relationID, HASH_FIND, NULL);
+	if (entry)
+		PGrnObjectCacheRemove(entry);
+}
+
+void
+PGrnInitializeObjectCache(void)
+{
+	HASHCTL hashControl;
+
+	hashControl.keysize = sizeof(Oid);
+	hashControl.entrysize = sizeof(PGrnObjectCacheEntry);
+	entries = hash_create("PGroonga object cache",
+						  32,
+						  &hashControl,
+						  HASH_ELEM | HASH_BLOBS);
+
+	/* Relation cache callbacks can't be unregistered. */
+	if (!callbackRegistered)
+	{
+		CacheRegisterRelcacheCallback(PGrnObjectCacheInvalidateRelation,
+									  (Datum) 0);
+		callbackRegistered = true;
+	}
+}
+
+void
+PGrnFinalizeObjectCache(void)
+{
+	if (!entries)
+		return;
+
+	PGrnObjectCacheRemoveAll();
+	hash_destroy(entries);
+	entries = NULL;
+}
+
+PGrnObjectCacheEntry *
+PGrnObjectCacheGet(Relation index)
+{
+	PGrnObjectCacheEntry *entry;
+	bool found;
+	unsigned int nAttributes;
+
+	if (!entries)
+		return NULL;
+
+	entry = hash_search(entries, &(index->rd_id), HASH_ENTER, &found);
+	if (found)
+	{
+		if (entry->nodeID == index->rd_node.relNode)
+			return entry;
+		/* REINDEX changes the relation file node. */
+		PGrnObjectCacheEntryFin(entry);
+	}
+
+	nAttributes = RelationGetDescr(index)->natts;
+	entry->nodeID = index->rd_node.relNode;
+	entry->nAttributes = nAttributes;
+	entry->sourcesTable = NULL;
+	entry->sourcesCtidColumn = NULL;
+	entry->sourcesColumns = NULL;
+	entry->lexicons =
+		MemoryContextAllocZero(TopMemoryContext,
+							   sizeof(grn_obj *) * nAttributes);
+	entry->indexColumns =
+		MemoryContextAllocZero(TopMemoryContext,
+							   sizeof(grn_obj *) * nAttributes);
+	return entry;
+}
+
+/*
+ * Removes all entries. It's used when objects may be removed without
+ * knowing the relation file node.
+ */
+void
+PGrnObjectCacheClear(void)
+{
+	if (!entries)
+		return;
+
+	PGrnObjectCacheRemoveAll();
+}
+
+void
+PGrnObjectCacheRemoveByNodeID(Oid nodeID)
+{
+	HASH_SEQ_STATUS status;
+	PGrnObjectCacheEntry *entry;
+
+	if (!entries)
+		return;
+
+	hash_seq_init(&status, entries);
+	while ((entry = hash_seq_search(&status)))
+	{
+		if (entry->nodeID != nodeID)
+			continue;
+		PGrnObjectCacheRemove(entry);
+	}
+}
+
+/*
+ * Resolves information of the column. The name is allocated in
+ * CurrentMemoryContext.
+ */
+void
+PGrnObjectCacheColumnInit(PGrnObjectCacheColumn column, grn_obj *object)
+{
+	char name[GRN_TABLE_MAX_KEY_SIZE];
+
+	column->column = object;
+	column->range = grn_obj_get_range(ctx, object);
+	column->nameSize = grn_column_name(ctx, object, name, sizeof(name));
+	column->name = pnstrdup(name, column->nameSize);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <postgres.h>
+#include <utils/rel.h>
+
+#include <groonga.h>
+
+typedef struct PGrnObjectCacheColumnData
+{
+	grn_obj *column;
+	grn_id range;
+	/* Used for WAL. */
+	char *name;
+	int nameSize;
+} PGrnObjectCacheColumnData;
+
+typedef PGrnObjectCacheColumnData *PGrnObjectCacheColumn;
+
+typedef struct PGrnObjectCacheEntry
+{
+	Oid indexID;
+	Oid nodeID;
+	unsigned int nAttributes;
+	grn_obj *sourcesTable;
+	grn_obj *sourcesCtidColumn;
+	/* All elements are set at once by PGrnLookupSourcesColumns(). */
+	PGrnObjectCacheColumn sourcesColumns;
+	grn_obj **lexicons;
+	grn_obj **indexColumns;
+} PGrnObjectCacheEntry;
+
+void PGrnInitializeObjectCache(void);
+void PGrnFinalizeObjectCache(void);
+
+PGrnObjectCacheEntry *PGrnObjectCacheGet(Relation index);
+void PGrnObjectCacheRemoveByNodeID(Oid nodeID);
+void PGrnObjectCacheClear(void);
+
+void PGrnObjectCacheColumnInit(PGrnObjectCacheColumn column,
+							   grn_obj *object);
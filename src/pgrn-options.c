@@ -29,6 +29,7 @@ typedef struct PGrnOptions
 	int normalizersOffset;
 	int normalizersMappingOffset;
 	int indexFlagsMappingOffset;
+	bool fastUpdate;
 } PGrnOptions;
 
 static relopt_kind PGrnReloptionKind;
@@ -456,6 +457,12 @@ PGrnInitializeOptions(void)
 							  NULL,
 							  PGrnOptionValidateIndexFlagsMapping,
 							  lock_mode);
+	pgrn_add_bool_reloption(PGrnReloptionKind,
+							"fast_update",
+							"Insert new records into pending list "
+							"and merge them to index in bulk",
+							false,
+							lock_mode);
 }
 
 void
@@ -771,6 +778,18 @@ PGrnOptionsGetExprParseFlags(Relation index)
 	return flags;
 }
 
+bool
+PGrnOptionsGetFastUpdate(Relation index)
+{
+	PGrnOptions *options;
+
+	options = (PGrnOptions *) (index->rd_options);
+	if (!options)
+		return false;
+
+	return options->fastUpdate;
+}
+
 bytea *
 pgroonga_options_raw(Datum reloptions,
 					 bool validate)
@@ -801,6 +820,8 @@ pgroonga_options_raw(Datum reloptions,
 		 offsetof(PGrnOptions, normalizersMappingOffset)},
 		{"index_flags_mapping", RELOPT_TYPE_STRING,
 		 offsetof(PGrnOptions, indexFlagsMappingOffset)},
+		{"fast_update", RELOPT_TYPE_BOOL,
+		 offsetof(PGrnOptions, fastUpdate)},
 	};
 
 #ifdef PGRN_HAVE_BUILD_RELOPTIONS
@@ -27,6 +27,7 @@ void PGrnApplyOptionValues(Relation index,
 						   grn_column_flags *indexFlags);
 
 grn_expr_flags PGrnOptionsGetExprParseFlags(Relation index);
+bool PGrnOptionsGetFastUpdate(Relation index);
 
 bytea *pgroonga_options_raw(Datum reloptions,
 							bool validate);
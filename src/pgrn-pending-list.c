@@ -0,0 +1,470 @@
+#include "pgroonga.h"
+
+#include "pgrn-column-name.h"
+#include "pgrn-ctid.h"
+#include "pgrn-global.h"
+#include "pgrn-groonga.h"
+#include "pgrn-jsonb.h"
+#include "pgrn-options.h"
+#include "pgrn-pending-list.h"
+#include "pgrn-wal.h"
+#include "pgrn-writable.h"
+
+#include <storage/lmgr.h>
+
+/*
+ * Pending list is a Groonga table that has the same data columns as
+ * the sources table. No index column refers it. So inserting a record
+ * into it doesn't update inverted indexes. Records in it are moved
+ * to the sources table in bulk.
+ *
+ * Adding a record to the pending list and merging the pending list are
+ * serialized by a heavyweight page lock like GIN's pending list
+ * cleanup. Without it, merge may read a record that is added but
+ * doesn't have ctid and values yet. The page lock is just a lock tag.
+ * Pending list isn't used with WAL. So no page is needed for it.
+ */
+#define PGRN_PENDING_LIST_LOCK_BLOCK_NUMBER 0
+
+static grn_ctx *ctx = &PGrnContext;
+static struct PGrnBuffers *buffers = &PGrnBuffers;
+
+static grn_obj *
+PGrnPendingListLookup(Relation index)
+{
+	char name[GRN_TABLE_MAX_KEY_SIZE];
+
+	snprintf(name, sizeof(name),
+			 PGrnPendingSourcesTableNameFormat,
+			 index->rd_node.relNode);
+	return grn_ctx_get(ctx, name, -1);
+}
+
+void
+PGrnPendingListLock(Relation index)
+{
+	LockPage(index, PGRN_PENDING_LIST_LOCK_BLOCK_NUMBER, ExclusiveLock);
+}
+
+void
+PGrnPendingListUnlock(Relation index)
+{
+	UnlockPage(index, PGRN_PENDING_LIST_LOCK_BLOCK_NUMBER, ExclusiveLock);
+}
+
+bool
+PGrnPendingListIsAvailable(Relation index)
+{
+	TupleDesc desc = RelationGetDescr(index);
+
+	if (!PGrnOptionsGetFastUpdate(index))
+		return false;
+
+	/* Merged records aren't written to WAL. */
+	if (PGrnWALGetEnabled())
+		return false;
+
+	/* JSONB values are inserted into other tables. */
+	if (desc->natts == 1 &&
+		PGrnAttributeIsJSONB(TupleDescAttr(desc, 0)->atttypid))
+		return false;
+
+	return true;
+}
+
+grn_obj *
+PGrnPendingListEnsure(Relation index)
+{
+	char name[GRN_TABLE_MAX_KEY_SIZE];
+	grn_obj *pendingList;
+	grn_obj *sourcesTable;
+	TupleDesc desc;
+	unsigned int i;
+
+	pendingList = PGrnPendingListLookup(index);
+	if (pendingList)
+		return pendingList;
+
+	snprintf(name, sizeof(name),
+			 PGrnPendingSourcesTableNameFormat,
+			 index->rd_node.relNode);
+	pendingList = PGrnCreateTable(index,
+								  name,
+								  GRN_OBJ_TABLE_NO_KEY,
+								  NULL,
+								  NULL,
+								  NULL,
+								  NULL);
+	PGrnCreateColumn(index,
+					 pendingList,
+					 PGrnSourcesCtidColumnName,
+					 GRN_OBJ_COLUMN_SCALAR,
+					 grn_ctx_at(ctx, GRN_DB_UINT64));
+
+	sourcesTable = PGrnLookupSourcesTable(index, ERROR);
+	desc = RelationGetDescr(index);
+	for (i = 0; i < desc->natts; i++)
+	{
+		const char *attributeName = TupleDescAttr(desc, i)->attname.data;
+		char columnName[GRN_TABLE_MAX_KEY_SIZE];
+		grn_obj *sourcesColumn;
+		grn_column_flags flags;
+
+		sourcesColumn = PGrnLookupColumn(sourcesTable, attributeName, ERROR);
+		flags = grn_column_get_flags(ctx, sourcesColumn) &
+			(GRN_OBJ_COLUMN_TYPE_MASK | GRN_OBJ_COMPRESS_MASK);
+		PGrnColumnNameEncode(attributeName, columnName);
+		PGrnCreateColumn(index,
+						 pendingList,
+						 columnName,
+						 flags,
+						 grn_ctx_at(ctx, grn_obj_get_range(ctx, sourcesColumn)));
+		grn_obj_unlink(ctx, sourcesColumn);
+	}
+
+	return pendingList;
+}
+
+static void
+PGrnPendingListMergeRecords(Relation index,
+							grn_obj *pendingList,
+							grn_obj *sourcesTable,
+							int64 *nMerged)
+{
+	const char *tag = "[pending-list][merge]";
+	TupleDesc desc = RelationGetDescr(index);
+	grn_obj *pendingCtidColumn;
+	grn_obj *sourcesCtidColumn = NULL;
+	grn_obj pendingColumns;
+	grn_obj sourcesColumns;
+	grn_obj *values;
+	grn_table_cursor *cursor;
+	grn_id id;
+	unsigned int i;
+
+	pendingCtidColumn = PGrnLookupColumn(pendingList,
+										 PGrnSourcesCtidColumnName,
+										 ERROR);
+	if (sourcesTable->header.type == GRN_TABLE_NO_KEY)
+		sourcesCtidColumn = PGrnLookupSourcesCtidColumn(index, ERROR);
+
+	GRN_PTR_INIT(&pendingColumns, GRN_OBJ_VECTOR, GRN_ID_NIL);
+	GRN_PTR_INIT(&sourcesColumns, GRN_OBJ_VECTOR, GRN_ID_NIL);
+	values = palloc(sizeof(grn_obj) * desc->natts);
+	for (i = 0; i < desc->natts; i++)
+	{
+		const char *attributeName = TupleDescAttr(desc, i)->attname.data;
+		GRN_PTR_PUT(ctx,
+					&pendingColumns,
+					PGrnLookupColumn(pendingList, attributeName, ERROR));
+		GRN_PTR_PUT(ctx,
+					&sourcesColumns,
+					PGrnLookupColumn(sourcesTable, attributeName, ERROR));
+		GRN_VOID_INIT(&(values[i]));
+	}
+
+	cursor = grn_table_cursor_open(ctx, pendingList,
+								   NULL, 0, NULL, 0,
+								   0, -1, 0);
+	PGrnCheck("%s failed to open cursor", tag);
+	while ((id = grn_table_cursor_next(ctx, cursor)) != GRN_ID_NIL)
+	{
+		uint64 packedCtid;
+		ItemPointerData ctid;
+		grn_id sourceID;
+
+		GRN_BULK_REWIND(&(buffers->ctid));
+		grn_obj_get_value(ctx, pendingCtidColumn, id, &(buffers->ctid));
+		if (GRN_BULK_VSIZE(&(buffers->ctid)) == 0)
+			packedCtid = 0;
+		else
+			packedCtid = GRN_UINT64_VALUE(&(buffers->ctid));
+		ctid = PGrnCtidUnpack(packedCtid);
+		if (!ItemPointerIsValid(&ctid))
+		{
+			/* It's a broken record. It must not be indexed. */
+			grn_table_cursor_delete(ctx, cursor);
+			PGrnCheck("%s failed to delete a broken pending record: <%u>",
+					  tag,
+					  id);
+			continue;
+		}
+
+		for (i = 0; i < desc->natts; i++)
+		{
+			grn_obj *pendingColumn = GRN_PTR_VALUE_AT(&pendingColumns, i);
+
+			grn_obj_reinit_for(ctx, &(values[i]), pendingColumn);
+			grn_obj_get_value(ctx, pendingColumn, id, &(values[i]));
+		}
+
+		/*
+		 * The pending record is deleted before the record is added to
+		 * the sources table. If adding fails, the record is missing
+		 * from the index until REINDEX but it's never found twice.
+		 */
+		grn_table_cursor_delete(ctx, cursor);
+		PGrnCheck("%s failed to delete a pending record: <%" PRIu64 ">",
+				  tag,
+				  packedCtid);
+
+		if (sourcesCtidColumn)
+		{
+			sourceID = grn_table_add(ctx, sourcesTable, NULL, 0, NULL);
+			if (sourceID != GRN_ID_NIL)
+				grn_obj_set_value(ctx,
+								  sourcesCtidColumn,
+								  sourceID,
+								  &(buffers->ctid),
+								  GRN_OBJ_SET);
+		}
+		else
+		{
+			sourceID = grn_table_add(ctx,
+									 sourcesTable,
+									 &packedCtid,
+									 sizeof(uint64),
+									 NULL);
+		}
+		PGrnCheck("%s failed to add a record: <%" PRIu64 ">",
+				  tag,
+				  packedCtid);
+		if (sourceID == GRN_ID_NIL)
+		{
+			PGrnCheckRC(GRN_UNKNOWN_ERROR,
+						"%s failed to add a record: <%" PRIu64 ">",
+						tag,
+						packedCtid);
+		}
+
+		for (i = 0; i < desc->natts; i++)
+		{
+			grn_obj *sourcesColumn = GRN_PTR_VALUE_AT(&sourcesColumns, i);
+
+			grn_obj_set_value(ctx,
+							  sourcesColumn,
+							  sourceID,
+							  &(values[i]),
+							  GRN_OBJ_SET);
+			PGrnCheck("%s failed to set column value", tag);
+		}
+
+		(*nMerged)++;
+	}
+	grn_table_cursor_close(ctx, cursor);
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		GRN_OBJ_FIN(ctx, &(values[i]));
+	}
+	pfree(values);
+	GRN_OBJ_FIN(ctx, &sourcesColumns);
+	GRN_OBJ_FIN(ctx, &pendingColumns);
+}
+
+bool
+PGrnPendingListExist(Relation index)
+{
+	return PGrnPendingListLookup(index) != NULL;
+}
+
+bool
+PGrnPendingListIsEmpty(Relation index)
+{
+	grn_obj *pendingList;
+
+	pendingList = PGrnPendingListLookup(index);
+	if (!pendingList)
+		return true;
+	return grn_table_size(ctx, pendingList) == 0;
+}
+
+/*
+ * Moves all records in the pending list to the sources table. Index
+ * columns for the sources table are updated for them.
+ */
+int64
+PGrnPendingListMerge(Relation index)
+{
+	const char *tag = "[pending-list][merge]";
+	grn_obj *pendingList;
+	grn_obj *sourcesTable;
+	int64 nMerged = 0;
+
+	pendingList = PGrnPendingListLookup(index);
+	if (!pendingList)
+		return 0;
+	if (grn_table_size(ctx, pendingList) == 0)
+		return 0;
+
+	if (!PGrnIsWritable())
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_E_MODIFYING_SQL_DATA_NOT_PERMITTED),
+				 errmsg("pgroonga: %s "
+						"can't merge pending records "
+						"while pgroonga.writable is false",
+						tag)));
+	}
+
+	sourcesTable = PGrnLookupSourcesTable(index, ERROR);
+
+	/* The lock is released on abort. */
+	PGrnPendingListLock(index);
+	PGrnPendingListMergeRecords(index, pendingList, sourcesTable, &nMerged);
+	PGrnPendingListUnlock(index);
+
+	GRN_LOG(ctx,
+			GRN_LOG_DEBUG,
+			"pgroonga: %s <%s>(%u): <%" PRId64 ">",
+			tag,
+			RelationGetRelationName(index),
+			RelationGetRelid(index),
+			nMerged);
+
+	return nMerged;
+}
+
+/*
+ * Adds all records in the pending list to the bitmap. They aren't
+ * searched by Groonga. So they are always rechecked.
+ */
+int64
+PGrnPendingListGetBitmap(Relation index, TIDBitmap *tbm)
+{
+	const char *tag = "[pending-list][get-bitmap]";
+	grn_obj *pendingList;
+	grn_obj *pendingCtidColumn;
+	grn_table_cursor *cursor;
+	grn_id id;
+	int64 nRecords = 0;
+
+	pendingList = PGrnPendingListLookup(index);
+	if (!pendingList)
+		return 0;
+	if (grn_table_size(ctx, pendingList) == 0)
+		return 0;
+
+	pendingCtidColumn = PGrnLookupColumn(pendingList,
+										 PGrnSourcesCtidColumnName,
+										 ERROR);
+	cursor = grn_table_cursor_open(ctx, pendingList,
+								   NULL, 0, NULL, 0,
+								   0, -1, 0);
+	PGrnCheck("%s failed to open cursor", tag);
+	while ((id = grn_table_cursor_next(ctx, cursor)) != GRN_ID_NIL)
+	{
+		ItemPointerData ctid;
+
+		GRN_BULK_REWIND(&(buffers->ctid));
+		grn_obj_get_value(ctx, pendingCtidColumn, id, &(buffers->ctid));
+		if (GRN_BULK_VSIZE(&(buffers->ctid)) == 0)
+			continue;
+		ctid = PGrnCtidUnpack(GRN_UINT64_VALUE(&(buffers->ctid)));
+		if (!ItemPointerIsValid(&ctid))
+			continue;
+		tbm_add_tuples(tbm, &ctid, 1, true);
+		nRecords++;
+	}
+	grn_table_cursor_close(ctx, cursor);
+
+	return nRecords;
+}
+
+static int
+PGrnPendingListComparePackedCtid(const void *a, const void *b)
+{
+	uint64 packedCtidA = *((const uint64 *) a);
+	uint64 packedCtidB = *((const uint64 *) b);
+
+	if (packedCtidA < packedCtidB)
+		return -1;
+	else if (packedCtidA > packedCtidB)
+		return 1;
+	else
+		return 0;
+}
+
+/*
+ * Collects packed ctids of all records in the pending list for index
+ * scan. They aren't searched by Groonga. So they must be rechecked.
+ * They are sorted for PGrnPendingListCtidsContain().
+ */
+int64
+PGrnPendingListCollectCtids(Relation index, grn_obj *packedCtids)
+{
+	const char *tag = "[pending-list][collect-ctids]";
+	grn_obj *pendingList;
+	grn_obj *pendingCtidColumn;
+	grn_table_cursor *cursor;
+	grn_id id;
+	int64 nRecords = 0;
+
+	GRN_BULK_REWIND(packedCtids);
+
+	pendingList = PGrnPendingListLookup(index);
+	if (!pendingList)
+		return 0;
+	if (grn_table_size(ctx, pendingList) == 0)
+		return 0;
+
+	pendingCtidColumn = PGrnLookupColumn(pendingList,
+										 PGrnSourcesCtidColumnName,
+										 ERROR);
+	cursor = grn_table_cursor_open(ctx, pendingList,
+								   NULL, 0, NULL, 0,
+								   0, -1, 0);
+	PGrnCheck("%s failed to open cursor", tag);
+	while ((id = grn_table_cursor_next(ctx, cursor)) != GRN_ID_NIL)
+	{
+		uint64 packedCtid;
+		ItemPointerData ctid;
+
+		GRN_BULK_REWIND(&(buffers->ctid));
+		grn_obj_get_value(ctx, pendingCtidColumn, id, &(buffers->ctid));
+		if (GRN_BULK_VSIZE(&(buffers->ctid)) == 0)
+			continue;
+		packedCtid = GRN_UINT64_VALUE(&(buffers->ctid));
+		ctid = PGrnCtidUnpack(packedCtid);
+		if (!ItemPointerIsValid(&ctid))
+			continue;
+		GRN_UINT64_PUT(ctx, packedCtids, packedCtid);
+		nRecords++;
+	}
+	grn_table_cursor_close(ctx, cursor);
+
+	qsort(GRN_BULK_HEAD(packedCtids),
+		  nRecords,
+		  sizeof(uint64),
+		  PGrnPendingListComparePackedCtid);
+
+	return nRecords;
+}
+
+bool
+PGrnPendingListCtidsContain(grn_obj *packedCtids, uint64 packedCtid)
+{
+	size_t nPackedCtids = GRN_BULK_VSIZE(packedCtids) / sizeof(uint64);
+
+	if (nPackedCtids == 0)
+		return false;
+
+	return bsearch(&packedCtid,
+				   GRN_BULK_HEAD(packedCtids),
+				   nPackedCtids,
+				   sizeof(uint64),
+				   PGrnPendingListComparePackedCtid) != NULL;
+}
+
+void
+PGrnPendingListRemoveRaw(Oid relationFileNodeID)
+{
+	char name[GRN_TABLE_MAX_KEY_SIZE];
+
+	snprintf(name, sizeof(name),
+			 PGrnPendingSourcesTableNameFormat,
+			 relationFileNodeID);
+	if (!grn_ctx_get(ctx, name, -1))
+		return;
+	PGrnRemoveObject(name);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <postgres.h>
+#include <nodes/tidbitmap.h>
+#include <utils/rel.h>
+
+#include <groonga.h>
+
+void PGrnPendingListLock(Relation index);
+void PGrnPendingListUnlock(Relation index);
+bool PGrnPendingListIsAvailable(Relation index);
+grn_obj *PGrnPendingListEnsure(Relation index);
+bool PGrnPendingListExist(Relation index);
+bool PGrnPendingListIsEmpty(Relation index);
+int64 PGrnPendingListMerge(Relation index);
+int64 PGrnPendingListGetBitmap(Relation index, TIDBitmap *tbm);
+int64 PGrnPendingListCollectCtids(Relation index, grn_obj *packedCtids);
+bool PGrnPendingListCtidsContain(grn_obj *packedCtids, uint64 packedCtid);
+void PGrnPendingListRemoveRaw(Oid relationFileNodeID);
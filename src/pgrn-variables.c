@@ -36,6 +36,7 @@ static int PGrnLockTimeout;
 
 static bool PGrnEnableWAL;
 static int PGrnMaxWALSizeKB;
+static int PGrnWALCompressionThreshold;
 
 static bool PGrnEnableCrashSafe;
 
@@ -189,6 +190,12 @@ PGrnMaxWALSizeAssign(int new_value, void *extra)
 	PGrnWALSetMaxSize(new_value * 1024);
 }
 
+static void
+PGrnWALCompressionThresholdAssign(int new_value, void *extra)
+{
+	PGrnWALSetCompressionThreshold(new_value);
+}
+
 static void
 PGrnMatchEscalationThresholdAssignRaw(int new_value)
 {
@@ -317,6 +324,22 @@ PGrnInitializeVariables(void)
 							PGrnMaxWALSizeAssign,
 							NULL);
 
+	DefineCustomIntVariable("pgroonga.wal_compression_threshold",
+							"Compress text values in WAL "
+							"that are larger than this size in bytes.",
+							"Compressed WAL can't be applied by old PGroonga. "
+							"The default is 0. "
+							"It means that WAL isn't compressed.",
+							&PGrnWALCompressionThreshold,
+							PGrnWALGetCompressionThreshold(),
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							PGrnWALCompressionThresholdAssign,
+							NULL);
+
 	DefineCustomBoolVariable("pgroonga.enable_crash_safe",
 							 "Enable crash safe feature.",
 							 "You also need to add 'pgroonga_crash_safer' to "
@@ -367,6 +390,56 @@ PGrnInitializeVariables(void)
 							 PGrnForceMatchEscalationAssign,
 							 NULL);
 
+	DefineCustomBoolVariable("pgroonga.enable_heap_order_scan",
+							 "Whether index scan returns tuples "
+							 "in heap order when no order is needed.",
+							 "Heap access becomes mostly sequential "
+							 "but matched records are sorted by ctid "
+							 "before the first tuple is returned. "
+							 "The default is off.",
+							 &PGrnEnableHeapOrderScan,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("pgroonga.thread_limit",
+							"Max number of threads used by Groonga "
+							"in maintenance operations.",
+							"Groonga uses multiple threads only while "
+							"building index columns by CREATE INDEX and "
+							"REINDEX. Normal queries always use 1 thread. "
+							"Multiple threads aren't used when "
+							"pgroonga.log_type is postgresql. "
+							"The default is 1.",
+							&PGrnThreadLimit,
+							1,
+							1,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pgroonga.pending_list_limit",
+							"Max number of records in pending list.",
+							"Records in pending list of an index that "
+							"uses fast_update are merged to the index "
+							"when the number of them reaches this value. "
+							"The default is 1000.",
+							&PGrnPendingListLimit,
+							1000,
+							1,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomStringVariable("pgroonga.libgroonga_version",
 							   "The used libgroonga version.",
 							   "It's runtime version "
@@ -391,3 +464,9 @@ PGrnVariablesApplyInitialValues(void)
 		grn_ctx_set_wal_role(&PGrnContext, GRN_WAL_ROLE_SECONDARY);
 	}
 }
+
+bool
+PGrnVariablesLogTypeIsPostgreSQL(void)
+{
+	return PGrnLogType == PGRN_LOG_TYPE_POSTGRESQL;
+}
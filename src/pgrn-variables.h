@@ -3,3 +3,5 @@
 void PGrnInitializeVariables(void);
 
 void PGrnVariablesApplyInitialValues(void);
+
+bool PGrnVariablesLogTypeIsPostgreSQL(void);
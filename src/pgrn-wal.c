@@ -5,6 +5,7 @@
 #include "pgrn-global.h"
 #include "pgrn-groonga.h"
 #include "pgrn-index-status.h"
+#include "pgrn-object-cache.h"
 #include "pgrn-wal.h"
 #include "pgrn-writable.h"
 
@@ -15,6 +16,7 @@
 
 static bool PGrnWALEnabled = false;
 static size_t PGrnWALMaxSize = 0;
+static size_t PGrnWALCompressionThreshold = 0;
 
 bool
 PGrnWALGetEnabled(void)
@@ -46,15 +48,29 @@ PGrnWALSetMaxSize(size_t size)
 	PGrnWALMaxSize = size;
 }
 
+size_t
+PGrnWALGetCompressionThreshold(void)
+{
+	return PGrnWALCompressionThreshold;
+}
+
+void
+PGrnWALSetCompressionThreshold(size_t size)
+{
+	PGrnWALCompressionThreshold = size;
+}
+
 #ifdef PGRN_SUPPORT_WAL
 #	include <access/generic_xlog.h>
 #	include <access/heapam.h>
 #	include <access/htup_details.h>
+#	include <common/pg_lzcompress.h>
 #	include <miscadmin.h>
 #	include <storage/bufmgr.h>
 #	include <storage/bufpage.h>
 #	include <storage/lmgr.h>
 #	include <storage/lockdefs.h>
+#	include <lib/stringinfo.h>
 #	include <utils/acl.h>
 #	include <utils/builtins.h>
 
@@ -116,6 +132,21 @@ struct PGrnWALData_
 	} current;
 	size_t nBuffers;
 	Buffer buffers[MAX_GENERIC_XLOG_PAGES];
+	/* The end of data written by the running flush. */
+	struct
+	{
+		BlockNumber block;
+		LocationIndex offset;
+	} writingPosition;
+	/* The end of flushed data. It's persisted by PGrnWALFinish() and
+	 * PGrnWALAbort(). */
+	struct
+	{
+		BlockNumber block;
+		LocationIndex offset;
+	} position;
+	/* Packed data that aren't written to pages yet. */
+	StringInfoData pending;
 	msgpack_packer packer;
 #endif
 };
@@ -168,6 +199,18 @@ struct PGrnWALData_
 #	endif
 #endif
 
+#ifdef PGRN_SUPPORT_WAL
+/*
+ * Compressed text is packed as ext type. Ext type isn't available
+ * with old msgpack.
+ */
+#	if MSGPACK_VERSION_MAJOR != 0
+#		define PGRN_WAL_SUPPORT_COMPRESSION
+#	endif
+/* Body: raw size (uint32_t) + data compressed by pglz */
+#	define PGRN_WAL_EXT_TYPE_PGLZ_TEXT 1
+#endif
+
 static void
 msgpack_pack_cstr(msgpack_packer *packer, const char *string)
 {
@@ -208,7 +251,31 @@ msgpack_pack_grn_obj(msgpack_packer *packer, grn_obj *object)
 
 #define PGRN_WAL_META_PAGE_BLOCK_NUMBER 0
 
+/*
+ * Packed data are buffered in backend local memory and written to
+ * pages in a group. It doesn't let concurrent writers run in parallel
+ * because they are serialized by the relation lock. See
+ * PGrnWALLockMode(). It just doesn't hold exclusive locks of the meta
+ * page and the current page while Groonga updates the target
+ * objects. So PGrnWALApplyNeeded() in other backends and buffer
+ * writes by checkpointer aren't blocked by a long running update.
+ *
+ * Data are written when they fill all data pages in a generic WAL
+ * record or when PGrnWALFinish() is called. Data that are larger than
+ * the buffer such as a large text value are written to pages directly
+ * without buffering. So the buffer never grows beyond this size.
+ */
+#define PGRN_WAL_PENDING_FLUSH_SIZE (BLCKSZ * (MAX_GENERIC_XLOG_PAGES - 1))
+
 #ifdef PGRN_SUPPORT_WAL
+/*
+ * Writers are serialized by this lock from PGrnWALStart() to
+ * PGrnWALFinish(). So WAL for an index is one stream and its order is
+ * the same as the order of changes in Groonga. WAL isn't split into
+ * multiple streams for concurrent writers. They would need to be
+ * merged in the order of changes in Groonga but it can't be decided
+ * without serializing writers.
+ */
 static LOCKMODE
 PGrnWALLockMode(void)
 {
@@ -435,13 +502,10 @@ PGrnWALPageWriterEnsureCurrent(PGrnWALData *data)
 	data->nUsedPages++;
 }
 
-static int
-PGrnWALPageWriter(void *userData,
-				  const char *buffer,
-				  MSGPACK_PACKER_WRITE_LENGTH_TYPE length)
+static void
+PGrnWALPageWrite(PGrnWALData *data, const char *buffer, size_t length)
 {
-	PGrnWALData *data = userData;
-	int written = 0;
+	size_t written = 0;
 	size_t rest = length;
 
 	while (written < length)
@@ -454,10 +518,10 @@ PGrnWALPageWriter(void *userData,
 		if (rest <= freeSize)
 		{
 			PGrnWALPageAppend(data->current.page, buffer, rest);
-			PGrnIndexStatusSetWALAppliedPosition(
-				data->index,
-				BufferGetBlockNumber(data->current.buffer),
-				PGrnWALPageGetLastOffset(data->current.page));
+			data->writingPosition.block =
+				BufferGetBlockNumber(data->current.buffer);
+			data->writingPosition.offset =
+				PGrnWALPageGetLastOffset(data->current.page);
 			written += rest;
 		}
 		else
@@ -471,14 +535,62 @@ PGrnWALPageWriter(void *userData,
 		if (PGrnWALPageGetFreeSize(data->current.page) == 0)
 			PGrnWALPageFilled(data);
 	}
+}
+
+static void
+PGrnWALDataWrite(PGrnWALData *data, const char *buffer, size_t length)
+{
+	data->state = GenericXLogStart(data->index);
+	PGrnWALDataInitNUsedPages(data);
+	PGrnWALDataInitMeta(data);
+	PGrnWALDataInitCurrent(data);
+	PGrnWALPageWrite(data, buffer, length);
+	GenericXLogFinish(data->state);
+	data->state = NULL;
+	data->position.block = data->writingPosition.block;
+	data->position.offset = data->writingPosition.offset;
+
+	PGrnWALDataReleaseBuffers(data);
+}
+
+static void
+PGrnWALDataFlush(PGrnWALData *data)
+{
+	if (data->pending.len == 0)
+		return;
+
+	PGrnWALDataWrite(data, data->pending.data, data->pending.len);
+	resetStringInfo(&(data->pending));
+}
+
+static int
+PGrnWALPendingWriter(void *userData,
+					 const char *buffer,
+					 MSGPACK_PACKER_WRITE_LENGTH_TYPE length)
+{
+	PGrnWALData *data = userData;
+
+	if (data->pending.len + length > PGRN_WAL_PENDING_FLUSH_SIZE)
+		PGrnWALDataFlush(data);
+
+	if (length >= PGRN_WAL_PENDING_FLUSH_SIZE)
+	{
+		PGrnWALDataWrite(data, buffer, length);
+		return 0;
+	}
 
-	return written;
+	appendBinaryStringInfo(&(data->pending), buffer, length);
+	if (data->pending.len >= PGRN_WAL_PENDING_FLUSH_SIZE)
+		PGrnWALDataFlush(data);
+
+	return 0;
 }
 
 static void
 PGrnWALDataInitMessagePack(PGrnWALData *data)
 {
-	msgpack_packer_init(&(data->packer), data, PGrnWALPageWriter);
+	initStringInfo(&(data->pending));
+	msgpack_packer_init(&(data->packer), data, PGrnWALPendingWriter);
 }
 #endif
 
@@ -499,12 +611,13 @@ PGrnWALStart(Relation index)
 	data = palloc(sizeof(PGrnWALData));
 
 	data->index = index;
-	data->state = GenericXLogStart(data->index);
+	data->state = NULL;
+	data->writingPosition.block = InvalidBlockNumber;
+	data->writingPosition.offset = 0;
+	data->position.block = InvalidBlockNumber;
+	data->position.offset = 0;
 
 	PGrnWALDataInitBuffers(data);
-	PGrnWALDataInitNUsedPages(data);
-	PGrnWALDataInitMeta(data);
-	PGrnWALDataInitCurrent(data);
 	PGrnWALDataInitMessagePack(data);
 
 	return data;
@@ -520,12 +633,17 @@ PGrnWALFinish(PGrnWALData *data)
 	if (!data)
 		return;
 
-	GenericXLogFinish(data->state);
+	PGrnWALDataFlush(data);
 
-	PGrnWALDataReleaseBuffers(data);
+	/* WAL written by this backend is already applied. */
+	if (BlockNumberIsValid(data->position.block))
+		PGrnIndexStatusSetWALAppliedPosition(data->index,
+											 data->position.block,
+											 data->position.offset);
 
 	UnlockRelation(data->index, PGrnWALLockMode());
 
+	pfree(data->pending.data);
 	pfree(data);
 #endif
 }
@@ -537,7 +655,19 @@ PGrnWALAbort(PGrnWALData *data)
 	if (!data)
 		return;
 
-	GenericXLogAbort(data->state);
+	/* It's not NULL only when an error is occurred while flushing. */
+	if (data->state)
+	{
+		GenericXLogAbort(data->state);
+		data->state = NULL;
+	}
+
+	/* Data flushed before the error are already applied by this
+	 * backend. They must not be applied again. */
+	if (BlockNumberIsValid(data->position.block))
+		PGrnIndexStatusSetWALAppliedPosition(data->index,
+											 data->position.block,
+											 data->position.offset);
 
 	if (!INTERRUPTS_CAN_BE_PROCESSED())
 	{
@@ -546,6 +676,7 @@ PGrnWALAbort(PGrnWALData *data)
 		UnlockRelation(data->index, PGrnWALLockMode());
 	}
 
+	pfree(data->pending.data);
 	pfree(data);
 #endif
 }
@@ -562,6 +693,15 @@ PGrnWALInsertStart(PGrnWALData *data,
 	if (!data)
 		return;
 
+	/* The sources table is the default target on apply. Omitting it
+	 * reduces WAL size for narrow records. */
+	if (table)
+	{
+		PGrnObjectCacheEntry *entry = PGrnObjectCacheGet(data->index);
+		if (entry && entry->sourcesTable == table)
+			table = NULL;
+	}
+
 	if (table)
 		nElements++;
 
@@ -694,12 +834,58 @@ PGrnWALInsertColumnValueRaw(PGrnWALData *data,
 	}
 }
 
+#ifdef PGRN_WAL_SUPPORT_COMPRESSION
+static bool
+PGrnWALInsertColumnValueCompressedText(PGrnWALData *data,
+									   const char *value,
+									   size_t valueSize)
+{
+	msgpack_packer *packer = &(data->packer);
+	uint32_t rawSize = valueSize;
+	char *compressed;
+	int32 compressedSize;
+
+	if (valueSize > PG_INT32_MAX)
+		return false;
+
+	compressed = palloc(sizeof(uint32_t) + PGLZ_MAX_OUTPUT(valueSize));
+	compressedSize = pglz_compress(value,
+								   valueSize,
+								   compressed + sizeof(uint32_t),
+								   PGLZ_strategy_default);
+	if (compressedSize < 0)
+	{
+		pfree(compressed);
+		return false;
+	}
+
+	memcpy(compressed, &rawSize, sizeof(uint32_t));
+	compressedSize += sizeof(uint32_t);
+	msgpack_pack_ext(packer, compressedSize, PGRN_WAL_EXT_TYPE_PGLZ_TEXT);
+	msgpack_pack_ext_body(packer, compressed, compressedSize);
+	pfree(compressed);
+	return true;
+}
+#endif
+
 static void
 PGrnWALInsertColumnValueBulk(PGrnWALData *data,
 							 const char *name,
 							 size_t nameSize,
 							 grn_obj *value)
 {
+#ifdef PGRN_WAL_SUPPORT_COMPRESSION
+	if (PGrnWALCompressionThreshold > 0 &&
+		GRN_BULK_VSIZE(value) >= PGrnWALCompressionThreshold &&
+		grn_type_id_is_text_family(ctx, value->header.domain))
+	{
+		if (PGrnWALInsertColumnValueCompressedText(data,
+												   GRN_BULK_HEAD(value),
+												   GRN_BULK_VSIZE(value)))
+			return;
+	}
+#endif
+
 	PGrnWALInsertColumnValueRaw(data,
 								name,
 								nameSize,
@@ -780,7 +966,6 @@ PGrnWALInsertColumn(PGrnWALData *data,
 					grn_obj *value)
 {
 #ifdef PGRN_SUPPORT_WAL
-	const char *tag = "[wal][insert][column]";
 	char name[GRN_TABLE_MAX_KEY_SIZE];
 	int nameSize;
 
@@ -788,6 +973,22 @@ PGrnWALInsertColumn(PGrnWALData *data,
 		return;
 
 	nameSize = grn_column_name(ctx, column, name, GRN_TABLE_MAX_KEY_SIZE);
+	PGrnWALInsertColumnWithName(data, name, nameSize, value);
+#endif
+}
+
+/* Use this when the column name is already known. It's faster. */
+void
+PGrnWALInsertColumnWithName(PGrnWALData *data,
+							const char *name,
+							size_t nameSize,
+							grn_obj *value)
+{
+#ifdef PGRN_SUPPORT_WAL
+	const char *tag = "[wal][insert][column]";
+
+	if (!data)
+		return;
 
 	PGrnWALInsertColumnStart(data, name, nameSize);
 
@@ -1057,6 +1258,8 @@ typedef struct {
 		LocationIndex offset;
 	} current;
 	grn_obj *sources;
+	/* (table ID, column name) -> column */
+	grn_hash *columns;
 } PGrnWALApplyData;
 
 static bool
@@ -1395,6 +1598,35 @@ PGrnWALApplyValueGetTableModules(const char *context,
 	return modules;
 }
 
+static grn_obj *
+PGrnWALApplyLookupColumn(PGrnWALApplyData *data,
+						 grn_obj *table,
+						 const char *name,
+						 size_t nameSize)
+{
+	char key[GRN_TABLE_MAX_KEY_SIZE];
+	unsigned int keySize;
+	grn_id tableID;
+	grn_obj *column;
+	void *value;
+
+	if (sizeof(grn_id) + nameSize > GRN_TABLE_MAX_KEY_SIZE)
+		return PGrnLookupColumnWithSize(table, name, nameSize, ERROR);
+
+	tableID = grn_obj_id(ctx, table);
+	memcpy(key, &tableID, sizeof(grn_id));
+	memcpy(key + sizeof(grn_id), name, nameSize);
+	keySize = sizeof(grn_id) + nameSize;
+	if (grn_hash_get(ctx, data->columns, key, keySize, &value) != GRN_ID_NIL)
+		return *((grn_obj **) value);
+
+	column = PGrnLookupColumnWithSize(table, name, nameSize, ERROR);
+	if (grn_hash_add(ctx, data->columns, key, keySize, &value, NULL) !=
+		GRN_ID_NIL)
+		*((grn_obj **) value) = column;
+	return column;
+}
+
 static void
 PGrnWALApplyInsertArray(PGrnWALApplyData *data,
 						msgpack_object_array *array,
@@ -1500,6 +1732,51 @@ PGrnWALApplyInsertArray(PGrnWALApplyData *data,
 	}
 }
 
+#ifdef PGRN_WAL_SUPPORT_COMPRESSION
+static void
+PGrnWALApplyInsertExt(PGrnWALApplyData *data,
+					  msgpack_object_ext *ext,
+					  grn_obj *value)
+{
+	const char *tag = "[wal][apply][insert][ext]";
+	uint32_t rawSize;
+	int32 decompressedSize;
+
+	if (ext->type != PGRN_WAL_EXT_TYPE_PGLZ_TEXT)
+	{
+		PGrnCheckRC(GRN_INVALID_ARGUMENT,
+					"%s unknown type: <%d>",
+					tag,
+					ext->type);
+	}
+	if (ext->size < sizeof(uint32_t))
+	{
+		PGrnCheckRC(GRN_INVALID_ARGUMENT,
+					"%s too small: <%u>",
+					tag,
+					ext->size);
+	}
+
+	memcpy(&rawSize, ext->ptr, sizeof(uint32_t));
+	grn_obj_reinit(ctx, value, GRN_DB_TEXT, 0);
+	grn_bulk_space(ctx, value, rawSize);
+	PGrnCheck("%s failed to allocate: <%u>", tag, rawSize);
+	decompressedSize =
+		pgrn_pglz_decompress(ext->ptr + sizeof(uint32_t),
+							 ext->size - sizeof(uint32_t),
+							 GRN_BULK_HEAD(value),
+							 rawSize);
+	if (decompressedSize != (int32) rawSize)
+	{
+		PGrnCheckRC(GRN_INVALID_ARGUMENT,
+					"%s failed to decompress: <%d>/<%u>",
+					tag,
+					decompressedSize,
+					rawSize);
+	}
+}
+#endif
+
 static void
 PGrnWALApplyInsert(PGrnWALApplyData *data,
 				   msgpack_object_map *map,
@@ -1563,10 +1840,10 @@ PGrnWALApplyInsert(PGrnWALApplyData *data,
 						key->type);
 		}
 
-		column = PGrnLookupColumnWithSize(table,
+		column = PGrnWALApplyLookupColumn(data,
+										  table,
 										  MSGPACK_OBJECT_VIA_STR(*key).ptr,
-										  MSGPACK_OBJECT_VIA_STR(*key).size,
-										  ERROR);
+										  MSGPACK_OBJECT_VIA_STR(*key).size);
 		switch (value->type)
 		{
 		case MSGPACK_OBJECT_BOOLEAN:
@@ -1597,13 +1874,16 @@ PGrnWALApplyInsert(PGrnWALApplyData *data,
 									walValue,
 									grn_obj_get_range(ctx, column));
 			break;
+#ifdef PGRN_WAL_SUPPORT_COMPRESSION
+		case MSGPACK_OBJECT_EXT:
+			PGrnWALApplyInsertExt(data, &(value->via.ext), walValue);
+			break;
+#endif
 /*
 		case MSGPACK_OBJECT_MAP:
 			break;
 		case MSGPACK_OBJECT_BIN:
 			break;
-		case MSGPACK_OBJECT_EXT:
-			break;
 */
 		default:
 			PGrnCheckRC(GRN_INVALID_ARGUMENT,
@@ -2086,7 +2366,27 @@ PGrnWALApply(Relation index)
 										 &(data.current.block),
 										 &(data.current.offset));
 	data.sources = NULL;
-	nAppliedOperations = PGrnWALApplyConsume(&data);
+	data.columns = grn_hash_create(ctx,
+								   NULL,
+								   GRN_TABLE_MAX_KEY_SIZE,
+								   sizeof(grn_obj *),
+								   GRN_OBJ_KEY_VAR_SIZE);
+	if (!data.columns)
+	{
+		PGrnCheck("[wal][apply] failed to create columns cache: <%s>",
+				  RelationGetRelationName(index));
+	}
+	PG_TRY();
+	{
+		nAppliedOperations = PGrnWALApplyConsume(&data);
+	}
+	PG_CATCH();
+	{
+		grn_hash_close(ctx, data.columns);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	grn_hash_close(ctx, data.columns);
 	UnlockRelation(index, PGrnWALLockMode());
 #endif
 	return nAppliedOperations;
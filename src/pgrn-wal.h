@@ -14,6 +14,9 @@ void PGrnWALDisable(void);
 size_t PGrnWALGetMaxSize(void);
 void PGrnWALSetMaxSize(size_t size);
 
+size_t PGrnWALGetCompressionThreshold(void);
+void PGrnWALSetCompressionThreshold(size_t size);
+
 PGrnWALData *PGrnWALStart(Relation index);
 void PGrnWALFinish(PGrnWALData *data);
 void PGrnWALAbort(PGrnWALData *data);
@@ -29,6 +32,10 @@ void PGrnWALInsertColumnFinish(PGrnWALData *data);
 void PGrnWALInsertColumn(PGrnWALData *data,
 						 grn_obj *column,
 						 grn_obj *value);
+void PGrnWALInsertColumnWithName(PGrnWALData *data,
+								 const char *name,
+								 size_t nameSize,
+								 grn_obj *value);
 void PGrnWALInsertKeyRaw(PGrnWALData *data,
 						 const void *key,
 						 size_t keySize);
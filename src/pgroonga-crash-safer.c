@@ -52,6 +52,7 @@ static volatile sig_atomic_t PGroongaCrashSaferGotSIGTERM = false;
 static volatile sig_atomic_t PGroongaCrashSaferGotSIGHUP = false;
 static volatile sig_atomic_t PGroongaCrashSaferGotSIGUSR1 = false;
 static int PGroongaCrashSaferFlushNaptime = 60;
+static int PGroongaCrashSaferThreadLimit = 1;
 static char *PGroongaCrashSaferLogPath;
 static int PGroongaCrashSaferLogLevel;
 PGRN_DEFINE_LOG_LEVEL_ENTRIES(PGroongaCrashSaferLogLevelEntries);
@@ -60,7 +61,9 @@ static const char *PGroongaCrashSaferLibraryName = "pgroonga_crash_safer";
 static uint32_t
 pgroonga_crash_safer_get_thread_limit(void *data)
 {
-	return 1;
+	/* Groonga's threads must not call PostgreSQL API. Crash safer
+	 * only uses file logger. */
+	return PGroongaCrashSaferThreadLimit;
 }
 
 static void
@@ -153,6 +156,15 @@ pgroonga_crash_safer_reindex_one(Datum databaseInfoDatum)
 									  i + 1,
 									  &isNull);
 			resetStringInfo(&buffer);
+			appendStringInfo(&buffer,
+							 TAG ": reindexing: "
+							 "%" PRIu64 "/%" PRIu64 ": <%.*s>",
+							 i + 1,
+							 (uint64) SPI_processed,
+							 (int) VARSIZE_ANY_EXHDR(indexName),
+							 VARDATA_ANY(indexName));
+			pgstat_report_activity(STATE_RUNNING, buffer.data);
+			resetStringInfo(&buffer);
 			appendStringInfo(&buffer,
 							 "REINDEX INDEX %.*s",
 							 (int) VARSIZE_ANY_EXHDR(indexName),
@@ -545,6 +557,22 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("pgroonga_crash_safer.thread_limit",
+							"Max number of threads used by Groonga "
+							"in crash safer.",
+							"The default is 1. "
+							"Use pgroonga.thread_limit for "
+							"REINDEX executed by crash safer.",
+							&PGroongaCrashSaferThreadLimit,
+							PGroongaCrashSaferThreadLimit,
+							1,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomStringVariable("pgroonga_crash_safer.log_path",
 							   "Log path for pgroonga-crash-safer.",
 							   "The default is "
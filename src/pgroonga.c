@@ -4,7 +4,9 @@
 
 #include "pgrn-alias.h"
 #include "pgrn-auto-close.h"
+#include "pgrn-column-name.h"
 #include "pgrn-command-escape-value.h"
+#include "pgrn-condition-cache.h"
 #include "pgrn-convert.h"
 #include "pgrn-crash-safer-statuses.h"
 #include "pgrn-create.h"
@@ -21,7 +23,9 @@
 #include "pgrn-match-positions-byte.h"
 #include "pgrn-match-positions-character.h"
 #include "pgrn-normalize.h"
+#include "pgrn-object-cache.h"
 #include "pgrn-options.h"
+#include "pgrn-pending-list.h"
 #include "pgrn-pg.h"
 #include "pgrn-portable.h"
 #include "pgrn-query-expand.h"
@@ -37,34 +41,48 @@
 #include "pgrn-writable.h"
 
 #include <access/amapi.h>
+#include <access/parallel.h>
 #include <access/reloptions.h>
 #include <access/relscan.h>
 #ifdef PGRN_SUPPORT_TABLEAM
+#	include <access/table.h>
 #	include <access/tableam.h>
 #endif
 #include <catalog/catalog.h>
 #include <catalog/index.h>
 #include <catalog/pg_type.h>
+#ifdef PGRN_SUPPORT_PROGRESS
+#	include <commands/progress.h>
+#endif
 #ifdef PGRN_INDEX_AM_ROUTINE_HAVE_AM_PARALLEL_VACUUM_OPTIONS
 #	include <commands/vacuum.h>
 #endif
 #include <mb/pg_wchar.h>
 #include <miscadmin.h>
 #include <nodes/nodeFuncs.h>
+#include <nodes/tidbitmap.h>
 #ifdef PGRN_HAVE_OPTIMIZER_H
 #	include <optimizer/optimizer.h>
 #else
 #	include <optimizer/clauses.h>
-#	include <optimizer/cost.h>
+#endif
+#include <optimizer/cost.h>
+#ifdef PGRN_SUPPORT_PARALLEL_BUILD
+#	include <optimizer/planner.h>
 #endif
 #include <pgstat.h>
+#include <port/atomics.h>
 #include <storage/bufmgr.h>
 #include <storage/ipc.h>
 #include <storage/latch.h>
+#include <storage/lwlock.h>
+#include <storage/shm_toc.h>
 #include <utils/array.h>
 #include <utils/builtins.h>
+#include <utils/datum.h>
 #include <utils/lsyscache.h>
 #include <utils/memutils.h>
+#include <utils/pg_locale.h>
 #include <utils/selfuncs.h>
 #include <utils/snapmgr.h>
 #include <utils/timestamp.h>
@@ -74,6 +92,8 @@
 
 #include <groonga.h>
 
+#include <xxhash.h>
+
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -84,14 +104,42 @@ static bool PGrnInitialized = false;
 bool PGrnGroongaInitialized = false;
 static bool PGrnCrashSaferInitialized = false;
 
+/*
+ * Groonga objects and types used to insert records. They are prepared
+ * once and used for many records.
+ */
+typedef struct PGrnInsertTargetData
+{
+	grn_obj *table;
+	grn_obj *ctidColumn;
+	PGrnObjectCacheColumn columns;
+	grn_id *rawDomains;
+	unsigned char *rawFlags;
+} PGrnInsertTargetData;
+
+typedef PGrnInsertTargetData *PGrnInsertTarget;
+
+/* Stored in IndexInfo::ii_AmCache. It's alive during a statement. */
+typedef struct PGrnInsertCacheData
+{
+	PGrnInsertTargetData target;
+	bool usePendingList;
+	bool needMaxRecordSizeUpdate;
+} PGrnInsertCacheData;
+
+typedef PGrnInsertCacheData *PGrnInsertCache;
+
 typedef struct PGrnBuildStateData
 {
-	grn_obj	*sourcesTable;
-	grn_obj	*sourcesCtidColumn;
+	PGrnInsertTargetData target;
 	double nIndexedTuples;
 	bool needMaxRecordSizeUpdate;
 	uint32_t maxRecordSize;
+	Size workMemSize;
+	bool reportProgress;
 	MemoryContext memoryContext;
+	/* Not NULL only for parallel index build. */
+	LWLock *insertLock;
 } PGrnBuildStateData;
 
 typedef PGrnBuildStateData *PGrnBuildState;
@@ -109,6 +157,7 @@ typedef struct PGrnPrimaryKeyColumn
 typedef struct PGrnScanOpaqueData
 {
 	Relation index;
+	IndexScanDesc scan;
 
 	MemoryContext memoryContext;
 
@@ -122,16 +171,30 @@ typedef struct PGrnScanOpaqueData
 	grn_obj *sorted;
 	grn_obj *targetTable;
 	grn_obj *indexCursor;
+	grn_obj *rangeFilter;
+	grn_ii_cursor *iiCursor;
 	grn_table_cursor *tableCursor;
 	grn_obj *ctidAccessor;
 	grn_obj *scoreAccessor;
 	grn_id currentID;
+	int sortOffset;
+	int sortLimit;
 
 	grn_obj canReturns;
+	grn_obj orderByIsScores;
+
+	uint64_t searchKeysHash;
+	grn_obj searchKeys;
+	uint64 searchedNWrites;
 
 	dlist_node node;
 	slist_head primaryKeyColumns;
 	grn_obj *scoreTargetRecords;
+
+	/* Packed ctids of pending records that are returned with recheck. */
+	grn_obj pendingCtids;
+	bool pendingCtidsCollected;
+	size_t pendingCtidsOffset;
 } PGrnScanOpaqueData;
 
 typedef PGrnScanOpaqueData *PGrnScanOpaque;
@@ -143,16 +206,54 @@ typedef struct PGrnPrefixRKSequentialSearchData
 	grn_obj *resultTable;
 } PGrnPrefixRKSequentialSearchData;
 
+/*
+ * All participants of a parallel index scan search the same records.
+ * Records are partitioned into slots by chunks of sources table record
+ * IDs. The first participant that finds a record in a slot owns the
+ * slot and only the owner returns records in the slot.
+ *
+ * The search itself isn't parallelized. Each participant runs the
+ * full Groonga search and walks all searched records. Only returning
+ * records, and the work by the upper plan nodes for them, is split.
+ * Slots are claimed by whoever reaches them first, so a participant
+ * that starts earlier may own most slots when searched records are
+ * sorted by score. Slots are keyed by record ID, not by cursor
+ * position, because the searches of the participants may see
+ * different records when VACUUM or INSERT runs concurrently.
+ *
+ * The leader merges pending records before the scan is shared, so
+ * that all participants search the same records and workers never
+ * write to Groonga. If the leader can't merge them because
+ * pgroonga.writable is false, the first participant scans all records
+ * and returns pending records with recheck.
+ */
+#define PGRN_PARALLEL_SCAN_CHUNK_SIZE 64
+#define PGRN_PARALLEL_SCAN_N_SLOTS 1024
+
 typedef struct PGrnParallelScanDescData {
-	slock_t mutex;
-	bool scanning;
+	pg_atomic_uint32 owners[PGRN_PARALLEL_SCAN_N_SLOTS];
+	bool pendingListMerged;
+	/* Used only when pendingListMerged is false. */
+	pg_atomic_uint32 allOwner;
 } PGrnParallelScanDescData;
 typedef PGrnParallelScanDescData *PGrnParallelScanDesc;
 
-static bool PGrnParallelScanAcquire(IndexScanDesc scan);
+/*
+ * The leader calls aminitparallelscan and then ambeginscan for the
+ * same index. ambeginscan doesn't know that the scan is parallel.
+ */
+static PGrnParallelScanDesc PGrnParallelScanInitializing = NULL;
+
+static void PGrnParallelScanMergePendingList(PGrnParallelScanDesc pgrnParallelScan,
+											 PGrnScanOpaque so);
+static bool PGrnParallelScanIsPendingListMerged(IndexScanDesc scan);
+static bool PGrnParallelScanOwnAll(IndexScanDesc scan);
+static bool PGrnParallelScanOwn(IndexScanDesc scan, grn_id sourceID);
 
 static dlist_head PGrnScanOpaques = DLIST_STATIC_INIT(PGrnScanOpaques);
 static unsigned int PGrnNScanOpaques = 0;
+/* Used to detect whether searched results are stale or not. */
+static uint64 PGrnNWrites = 0;
 
 extern PGDLLEXPORT void _PG_init(void);
 
@@ -262,6 +363,7 @@ PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_regexp_text);
 PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_regexp_varchar);
 PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_regexp_in_text);
 PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_regexp_in_varchar);
+PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_query_score_distance_text);
 
 PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_insert);
 PGDLLEXPORT PG_FUNCTION_INFO_V1(pgroonga_beginscan);
@@ -282,10 +384,18 @@ static struct PGrnBuffers *buffers = &PGrnBuffers;
 static PGrnSequentialSearchData sequentialSearchData;
 static PGrnPrefixRKSequentialSearchData prefixRKSequentialSearchData;
 
+static bool PGrnIsMaintenance = false;
+
 static uint32_t
 PGrnGetThreadLimit(void *data)
 {
-	return 1;
+	/* Groonga's threads must not call PostgreSQL API. The PostgreSQL
+	 * logger uses ereport(). */
+	if (!PGrnIsMaintenance)
+		return 1;
+	if (PGrnVariablesLogTypeIsPostgreSQL())
+		return 1;
+	return PGrnThreadLimit;
 }
 
 static grn_encoding
@@ -318,6 +428,7 @@ PGrnGetEncoding(void)
 }
 
 static void PGrnScanOpaqueFin(PGrnScanOpaque so);
+static void PGrnSearchDataFreeCached(void *value);
 
 static void
 PGrnReleaseScanOpaques(ResourceReleasePhase phase,
@@ -359,6 +470,8 @@ PGrnReleaseScanOpaques(ResourceReleasePhase phase,
 		break;
 	}
 
+	PGrnParallelScanInitializing = NULL;
+
 	dlist_foreach_modify(iter, &PGrnScanOpaques)
 	{
 		PGrnScanOpaque so;
@@ -410,6 +523,14 @@ PGrnBeforeShmemExit(int code, Datum arg)
 				db ? "opened" : "not-opened");
 		if (db)
 		{
+			GRN_LOG(ctx, GRN_LOG_DEBUG,
+					"%s[finalize][object-cache]", tag);
+			PGrnFinalizeObjectCache();
+
+			GRN_LOG(ctx, GRN_LOG_DEBUG,
+					"%s[finalize][condition-cache]", tag);
+			PGrnFinalizeConditionCache();
+
 			GRN_LOG(ctx, GRN_LOG_DEBUG, "%s[finalize][auto-close]", tag);
 			PGrnFinalizeAutoClose();
 
@@ -539,6 +660,10 @@ PGrnInitializeDatabase(void)
 	PGrnInitializeNormalize();
 
 	PGrnInitializeAutoClose();
+
+	PGrnInitializeConditionCache(PGrnSearchDataFreeCached);
+
+	PGrnInitializeObjectCache();
 }
 
 void
@@ -1207,6 +1332,42 @@ PGrnSetSources(Relation index, grn_obj *sourcesTable)
 	}
 }
 
+/*
+ * sourceID is a record ID in the sources table. Don't use
+ * so->ctidAccessor for it because it may be opened on so->sorted.
+ */
+static bool
+PGrnScanOpaqueResolvePackedCtid(PGrnScanOpaque so,
+								grn_id sourceID,
+								uint64 *packedCtid)
+{
+	if (so->sourcesCtidColumn)
+	{
+		GRN_BULK_REWIND(&(buffers->ctid));
+		grn_obj_get_value(ctx,
+						  so->sourcesCtidColumn,
+						  sourceID,
+						  &(buffers->ctid));
+		if (GRN_BULK_VSIZE(&(buffers->ctid)) != sizeof(uint64))
+			return false;
+		*packedCtid = GRN_UINT64_VALUE(&(buffers->ctid));
+	}
+	else
+	{
+		int keySize;
+
+		keySize = grn_table_get_key(ctx,
+									so->sourcesTable,
+									sourceID,
+									packedCtid,
+									sizeof(uint64));
+		if (keySize != sizeof(uint64))
+			return false;
+	}
+
+	return true;
+}
+
 static double
 PGrnCollectScoreGetScore(Relation table,
 						 PGrnScanOpaque so,
@@ -1214,19 +1375,18 @@ PGrnCollectScoreGetScore(Relation table,
 {
 	double score = 0.0;
 	grn_id id;
+	uint64 packedCtid;
 
 	id = grn_table_get(ctx, so->searched, &recordID, sizeof(grn_id));
 	if (id == GRN_ID_NIL)
 		return 0.0;
 
-	GRN_BULK_REWIND(&(buffers->ctid));
-	grn_obj_get_value(ctx, so->ctidAccessor, id, &(buffers->ctid));
-	if (GRN_BULK_VSIZE(&(buffers->ctid)) == 0)
+	if (!PGrnScanOpaqueResolvePackedCtid(so, recordID, &packedCtid))
 		return 0.0;
 
 	{
 		ItemPointerData ctid;
-		ctid = PGrnCtidUnpack(GRN_UINT64_VALUE(&(buffers->ctid)));
+		ctid = PGrnCtidUnpack(packedCtid);
 		if (!PGrnCtidIsAlive(table, &ctid))
 			return 0.0;
 	}
@@ -1410,6 +1570,8 @@ PGrnCollectScoreMultiColumnPrimaryKey(Relation table,
 	return score;
 }
 
+static void PGrnStreamSearchPrepareScore(PGrnScanOpaque so);
+
 static bool
 PGrnCollectScoreIsTarget(PGrnScanOpaque so, Oid tableOid)
 {
@@ -1429,6 +1591,8 @@ PGrnCollectScoreIsTarget(PGrnScanOpaque so, Oid tableOid)
 		return false;
 	}
 
+	PGrnStreamSearchPrepareScore(so);
+
 	if (!so->scoreAccessor)
 	{
 		GRN_LOG(ctx,
@@ -1954,6 +2118,8 @@ pgroonga_command(PG_FUNCTION_ARGS)
 					 0);
 	}
 	grn_ctx_recv_handler_set(ctx, NULL, NULL);
+	/* The command may remove cached objects. */
+	PGrnObjectCacheClear();
 
 	grn_obj_reinit(ctx, &(buffers->general), GRN_DB_TEXT, 0);
 	GRN_TEXT_PUT(ctx, &(buffers->general),
@@ -2897,6 +3063,20 @@ pgroonga_query_text(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(matched);
 }
 
+/**
+ * pgroonga_query_score_distance_text(target text, query text) : float8
+ *
+ * This is used only for ORDER BY. Index scan returns the negative
+ * score of the current search as the value. We can't compute score
+ * without index scan. So this returns a constant. Records are
+ * returned in no particular order for sequential scan and bitmap scan.
+ */
+Datum
+pgroonga_query_score_distance_text(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_FLOAT8(0.0);
+}
+
 static bool
 pgroonga_query_condition_raw(const char *target,
 							 unsigned int targetSize,
@@ -4555,9 +4735,163 @@ PGrnComputeSize(grn_obj *buffer)
 	}
 }
 
+static void
+PGrnInsertTargetInit(PGrnInsertTarget target,
+					 Relation index,
+					 grn_obj *table,
+					 grn_obj *ctidColumn)
+{
+	TupleDesc desc = RelationGetDescr(index);
+	PGrnObjectCacheEntry *entry;
+	bool useObjectCache;
+	unsigned int i;
+
+	target->table = table;
+	target->ctidColumn = ctidColumn;
+	target->columns = NULL;
+	target->rawDomains = NULL;
+	target->rawFlags = NULL;
+
+	/* PGrnJSONBInsert() uses its own columns. */
+	if (desc->natts == 1 &&
+		PGrnAttributeIsJSONB(TupleDescAttr(desc, 0)->atttypid))
+		return;
+
+	target->columns = palloc(sizeof(PGrnObjectCacheColumnData) * desc->natts);
+	target->rawDomains = palloc(sizeof(grn_id) * desc->natts);
+	target->rawFlags = palloc(sizeof(unsigned char) * desc->natts);
+	entry = PGrnObjectCacheGet(index);
+	useObjectCache = (entry && entry->sourcesTable == table);
+	if (useObjectCache)
+		PGrnLookupSourcesColumns(index, target->columns);
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute attribute = TupleDescAttr(desc, i);
+
+		if (!useObjectCache)
+		{
+			grn_obj *column = PGrnLookupColumn(table,
+											   attribute->attname.data,
+											   ERROR);
+			PGrnObjectCacheColumnInit(&(target->columns[i]), column);
+		}
+		target->rawDomains[i] = PGrnGetType(index,
+											i,
+											&(target->rawFlags[i]));
+	}
+}
+
+/*
+ * Converts all elements of a text vector to records of the table in
+ * one pass. It's used for prefix search against text[] and
+ * varchar[]. It's faster than casting each element by grn_obj_cast()
+ * because it doesn't need temporary objects for each element.
+ *
+ * It returns false when it can't be used. value isn't changed in the
+ * case.
+ */
+static bool
+PGrnInsertColumnCastTextVectorToRecords(grn_obj *rawValue,
+										grn_obj *table,
+										grn_obj *value,
+										grn_rc *rc)
+{
+	grn_id tableID;
+	uint32_t i, n;
+
+	if (!grn_obj_is_table_with_key(ctx, table))
+		return false;
+	if (!grn_type_id_is_text_family(ctx, table->header.domain))
+		return false;
+
+	n = grn_vector_size(ctx, rawValue);
+	/* NULL elements are converted by grn_obj_cast(). */
+	for (i = 0; i < n; i++)
+	{
+		const char *element;
+		if (grn_vector_get_element(ctx, rawValue, i, &element, NULL, NULL) == 0)
+			return false;
+	}
+
+	tableID = grn_obj_id(ctx, table);
+	*rc = GRN_SUCCESS;
+	for (i = 0; i < n; i++)
+	{
+		const char *element;
+		float weight;
+		uint32_t elementSize;
+		grn_id id;
+
+		elementSize = grn_vector_get_element_float(ctx,
+												   rawValue,
+												   i,
+												   &element,
+												   &weight,
+												   NULL);
+		id = grn_table_add(ctx, table, element, elementSize, NULL);
+		if (id == GRN_ID_NIL)
+		{
+			*rc = (ctx->rc == GRN_SUCCESS) ? GRN_INVALID_ARGUMENT : ctx->rc;
+			break;
+		}
+		grn_vector_add_element_float(ctx,
+									 value,
+									 (const char *) &id,
+									 sizeof(grn_id),
+									 weight,
+									 tableID);
+	}
+	return true;
+}
+
+static grn_rc
+PGrnInsertColumnCastVector(grn_obj *rawValue,
+						   grn_id rawDomain,
+						   grn_id domain,
+						   grn_obj *value)
+{
+	grn_rc rc = GRN_SUCCESS;
+	grn_obj rawElement;
+	grn_obj *element = &(buffers->castElement);
+	uint32_t i, n;
+
+	/* Temporary objects are initialized only once. */
+	GRN_VALUE_VAR_SIZE_INIT(&rawElement, GRN_OBJ_DO_SHALLOW_COPY, rawDomain);
+	grn_obj_reinit(ctx, element, domain, 0);
+	n = grn_vector_size(ctx, rawValue);
+	for (i = 0; i < n; i++)
+	{
+		const char *elementValue;
+		float weight;
+		grn_id elementDomain;
+		uint32_t elementSize =
+			grn_vector_get_element_float(ctx,
+										 rawValue,
+										 i,
+										 &elementValue,
+										 &weight,
+										 &elementDomain);
+		rawElement.header.domain = elementDomain;
+		GRN_TEXT_SET(ctx, &rawElement, elementValue, elementSize);
+		GRN_BULK_REWIND(element);
+		rc = grn_obj_cast(ctx, &rawElement, element, true);
+		if (rc != GRN_SUCCESS)
+			break;
+		grn_vector_add_element_float(ctx,
+									 value,
+									 GRN_BULK_HEAD(element),
+									 GRN_BULK_VSIZE(element),
+									 weight,
+									 domain);
+	}
+	GRN_OBJ_FIN(ctx, &rawElement);
+
+	return rc;
+}
+
 static uint32_t
 PGrnInsertColumn(Relation index,
-				 grn_obj *sourcesTable,
+				 PGrnInsertTarget target,
 				 Datum *values,
 				 PGrnWALData *walData,
 				 unsigned int i,
@@ -4567,17 +4901,28 @@ PGrnInsertColumn(Relation index,
 	TupleDesc desc = RelationGetDescr(index);
 	Form_pg_attribute attribute = TupleDescAttr(desc, i);
 	NameData *name = &(attribute->attname);
-	grn_obj *dataColumn = PGrnLookupColumn(sourcesTable, name->data, ERROR);
+	PGrnObjectCacheColumn column = &(target->columns[i]);
+	grn_obj *dataColumn = column->column;
 	grn_obj *rawValue = &(buffers->general);
+	grn_obj rawValueReference;
 	grn_obj *value;
-	grn_id rawDomain;
-	unsigned char flags;
+	grn_id rawDomain = target->rawDomains[i];
+	unsigned char flags = target->rawFlags[i];
 	grn_id domain;
 
-	rawDomain = PGrnGetType(index, i, &flags);
-	grn_obj_reinit(ctx, rawValue, rawDomain, flags);
+	if (PGrnConvertFromDataCanRefer(attribute->atttypid))
+	{
+		/* Large text isn't copied until grn_obj_set_value(). The
+		 * detoasted datum is alive until this function returns. */
+		rawValue = &rawValueReference;
+		GRN_VALUE_VAR_SIZE_INIT(rawValue, GRN_OBJ_DO_SHALLOW_COPY, rawDomain);
+	}
+	else
+	{
+		grn_obj_reinit(ctx, rawValue, rawDomain, flags);
+	}
 	PGrnConvertFromData(values[i], attribute->atttypid, rawValue);
-	domain = grn_obj_get_range(ctx, dataColumn);
+	domain = column->range;
 	if (domain == rawDomain)
 	{
 		value = rawValue;
@@ -4592,39 +4937,14 @@ PGrnInsertColumn(Relation index,
 		grn_obj_reinit(ctx, value, domain, flags);
 		if (grn_obj_is_vector(ctx, rawValue))
 		{
-			uint32_t n = grn_vector_size(ctx, rawValue);
-			uint32_t i;
-			for (i = 0; i < n; i++)
-			{
-				const char *elementValue;
-				float weight;
-				grn_id elementDomain;
-				uint32_t elementSize =
-					grn_vector_get_element_float(ctx,
-												 rawValue,
-												 i,
-												 &elementValue,
-												 &weight,
-												 &elementDomain);
-				GRN_OBJ_FIN(ctx, &rawElement);
-				GRN_VALUE_VAR_SIZE_INIT(&rawElement,
-										GRN_OBJ_DO_SHALLOW_COPY,
-										elementDomain);
-				GRN_TEXT_SET(ctx,
-							 &rawElement,
-							 elementValue,
-							 elementSize);
-				grn_obj_reinit(ctx, element, domain, 0);
-				rc = grn_obj_cast(ctx, &rawElement, element, true);
-				if (rc != GRN_SUCCESS)
-					break;
-				grn_vector_add_element_float(ctx,
-											 value,
-											 GRN_BULK_HEAD(element),
-											 GRN_BULK_VSIZE(element),
-											 weight,
-											 domain);
-			}
+			if (!PGrnInsertColumnCastTextVectorToRecords(rawValue,
+														 grn_ctx_at(ctx, domain),
+														 value,
+														 &rc))
+				rc = PGrnInsertColumnCastVector(rawValue,
+												rawDomain,
+												domain,
+												value);
 		}
 		else if (grn_obj_is_uvector(ctx, value))
 		{
@@ -4677,21 +4997,25 @@ PGrnInsertColumn(Relation index,
 	grn_obj_set_value(ctx, dataColumn, id, value, GRN_OBJ_SET);
 	PGrnCheck("%s failed to set column value", tag);
 
-	PGrnWALInsertColumn(walData, dataColumn, rawValue);
+	PGrnWALInsertColumnWithName(walData,
+								column->name,
+								column->nameSize,
+								rawValue);
 
 	return PGrnComputeSize(value);
 }
 
 static uint32_t
 PGrnInsert(Relation index,
-		   grn_obj *sourcesTable,
-		   grn_obj *sourcesCtidColumn,
+		   PGrnInsertTarget target,
 		   Datum *values,
 		   bool *isnull,
 		   ItemPointer ht_ctid)
 {
 	const char *tag = "[insert]";
 	TupleDesc desc = RelationGetDescr(index);
+	grn_obj *sourcesTable = target->table;
+	grn_obj *sourcesCtidColumn = target->ctidColumn;
 	grn_id id;
 	PGrnWALData *walData;
 	uint64 packedCtid = PGrnCtidPack(ht_ctid);
@@ -4793,7 +5117,7 @@ PGrnInsert(Relation index,
 			if (isnull[i])
 				continue;
 			recordSize += PGrnInsertColumn(index,
-										   sourcesTable,
+										   target,
 										   values,
 										   walData,
 										   i,
@@ -4814,6 +5138,45 @@ PGrnInsert(Relation index,
 	return recordSize;
 }
 
+static PGrnInsertCache
+PGrnInsertCacheGet(Relation index, struct IndexInfo *indexInfo)
+{
+	MemoryContext oldMemoryContext = NULL;
+	PGrnInsertCache cache;
+	grn_obj *table;
+	grn_obj *ctidColumn = NULL;
+
+	if (indexInfo && indexInfo->ii_AmCache)
+		return indexInfo->ii_AmCache;
+
+	if (indexInfo)
+		oldMemoryContext = MemoryContextSwitchTo(indexInfo->ii_Context);
+
+	cache = palloc(sizeof(PGrnInsertCacheData));
+	cache->usePendingList = PGrnPendingListIsAvailable(index);
+	if (cache->usePendingList)
+	{
+		table = PGrnPendingListEnsure(index);
+		ctidColumn = PGrnLookupColumn(table, PGrnSourcesCtidColumnName, ERROR);
+	}
+	else
+	{
+		table = PGrnLookupSourcesTable(index, ERROR);
+		if (table->header.type == GRN_TABLE_NO_KEY)
+			ctidColumn = PGrnLookupSourcesCtidColumn(index, ERROR);
+	}
+	PGrnInsertTargetInit(&(cache->target), index, table, ctidColumn);
+	cache->needMaxRecordSizeUpdate = PGrnNeedMaxRecordSizeUpdate(index);
+
+	if (indexInfo)
+	{
+		MemoryContextSwitchTo(oldMemoryContext);
+		indexInfo->ii_AmCache = cache;
+	}
+
+	return cache;
+}
+
 static bool
 pgroonga_insert_raw(Relation index,
 					Datum *values,
@@ -4827,8 +5190,7 @@ pgroonga_insert_raw(Relation index,
 					struct IndexInfo *indexInfo)
 {
 	const char *tag = "[insert]";
-	grn_obj *sourcesTable;
-	grn_obj *sourcesCtidColumn = NULL;
+	PGrnInsertCache cache;
 	uint32_t recordSize;
 
 	if (!PGrnIsWritable())
@@ -4843,18 +5205,22 @@ pgroonga_insert_raw(Relation index,
 
 	PGrnWALApply(index);
 
-	sourcesTable = PGrnLookupSourcesTable(index, ERROR);
-	if (sourcesTable->header.type == GRN_TABLE_NO_KEY)
-	{
-		sourcesCtidColumn = PGrnLookupSourcesCtidColumn(index, ERROR);
-	}
+	cache = PGrnInsertCacheGet(index, indexInfo);
+	/* The lock is released on abort. */
+	if (cache->usePendingList)
+		PGrnPendingListLock(index);
 	recordSize = PGrnInsert(index,
-							sourcesTable,
-							sourcesCtidColumn,
+							&(cache->target),
 							values,
 							isnull,
 							ctid);
-	if (PGrnNeedMaxRecordSizeUpdate(index))
+	if (cache->usePendingList)
+		PGrnPendingListUnlock(index);
+	if (cache->usePendingList &&
+		grn_table_size(ctx, cache->target.table) >= PGrnPendingListLimit)
+		PGrnPendingListMerge(index);
+	PGrnNWrites++;
+	if (cache->needMaxRecordSizeUpdate)
 		PGrnUpdateMaxRecordSize(index, recordSize);
 	grn_db_touch(ctx, grn_ctx_db(ctx));
 
@@ -4993,6 +5359,7 @@ PGrnScanOpaqueInit(PGrnScanOpaque so, Relation index)
 			PGrnNScanOpaques);
 
 	so->index = index;
+	so->scan = NULL;
 
 	so->memoryContext =
 		AllocSetContextCreate(CurrentMemoryContext,
@@ -5016,18 +5383,31 @@ PGrnScanOpaqueInit(PGrnScanOpaque so, Relation index)
 	so->sorted = NULL;
 	so->targetTable = NULL;
 	so->indexCursor = NULL;
+	so->rangeFilter = NULL;
+	so->iiCursor = NULL;
 	so->tableCursor = NULL;
 	so->ctidAccessor = NULL;
 	so->scoreAccessor = NULL;
 	so->currentID = GRN_ID_NIL;
+	so->sortOffset = 0;
+	so->sortLimit = 0;
 
 	GRN_BOOL_INIT(&(so->canReturns), GRN_OBJ_VECTOR);
+	GRN_BOOL_INIT(&(so->orderByIsScores), GRN_OBJ_VECTOR);
+
+	so->searchKeysHash = 0;
+	GRN_TEXT_INIT(&(so->searchKeys), 0);
+	so->searchedNWrites = 0;
 
 	dlist_push_head(&PGrnScanOpaques, &(so->node));
 	PGrnNScanOpaques++;
 	PGrnScanOpaqueInitPrimaryKeyColumns(so);
 	so->scoreTargetRecords = NULL;
 
+	GRN_UINT64_INIT(&(so->pendingCtids), GRN_OBJ_VECTOR);
+	so->pendingCtidsCollected = false;
+	so->pendingCtidsOffset = 0;
+
 	GRN_LOG(ctx, GRN_LOG_DEBUG,
 			"pgroonga: [initialize][scan-opaque][end] %u: <%p>",
 			PGrnNScanOpaques,
@@ -5035,9 +5415,11 @@ PGrnScanOpaqueInit(PGrnScanOpaque so, Relation index)
 }
 
 static void
-PGrnScanOpaqueReinit(PGrnScanOpaque so)
+PGrnScanOpaqueReinitCursor(PGrnScanOpaque so)
 {
 	so->currentID = GRN_ID_NIL;
+	so->sortOffset = 0;
+	so->sortLimit = 0;
 	if (so->scoreAccessor)
 	{
 		grn_obj_unlink(ctx, so->scoreAccessor);
@@ -5053,6 +5435,16 @@ PGrnScanOpaqueReinit(PGrnScanOpaque so)
 		grn_obj_close(ctx, so->indexCursor);
 		so->indexCursor = NULL;
 	}
+	if (so->rangeFilter)
+	{
+		grn_obj_close(ctx, so->rangeFilter);
+		so->rangeFilter = NULL;
+	}
+	if (so->iiCursor)
+	{
+		grn_ii_cursor_close(ctx, so->iiCursor);
+		so->iiCursor = NULL;
+	}
 	if (so->tableCursor)
 	{
 		grn_table_cursor_close(ctx, so->tableCursor);
@@ -5070,11 +5462,22 @@ PGrnScanOpaqueReinit(PGrnScanOpaque so)
 		grn_obj_close(ctx, so->sorted);
 		so->sorted = NULL;
 	}
+	GRN_BULK_REWIND(&(so->pendingCtids));
+	so->pendingCtidsCollected = false;
+	so->pendingCtidsOffset = 0;
+}
+
+static void
+PGrnScanOpaqueReinit(PGrnScanOpaque so)
+{
+	PGrnScanOpaqueReinitCursor(so);
 	if (so->searched)
 	{
 		grn_obj_close(ctx, so->searched);
 		so->searched = NULL;
 	}
+	so->searchKeysHash = 0;
+	GRN_BULK_REWIND(&(so->searchKeys));
 	GRN_BULK_REWIND(&(so->canReturns));
 }
 
@@ -5102,6 +5505,11 @@ PGrnScanOpaqueFin(PGrnScanOpaque so)
 	GRN_OBJ_FIN(ctx, &(so->maxBorderValue));
 
 	GRN_OBJ_FIN(ctx, &(so->canReturns));
+	GRN_OBJ_FIN(ctx, &(so->orderByIsScores));
+
+	GRN_OBJ_FIN(ctx, &(so->searchKeys));
+
+	GRN_OBJ_FIN(ctx, &(so->pendingCtids));
 
 	free(so);
 
@@ -5118,17 +5526,35 @@ pgroonga_beginscan_raw(Relation index,
 {
 	IndexScanDesc scan;
 	PGrnScanOpaque so;
+	PGrnParallelScanDesc pgrnParallelScan = PGrnParallelScanInitializing;
+
+	PGrnParallelScanInitializing = NULL;
 
 	scan = RelationGetIndexScan(index, nKeys, nOrderBys);
 
 	so = (PGrnScanOpaque) malloc(sizeof(PGrnScanOpaqueData));
 	PGrnScanOpaqueInit(so, index);
 
+	if (pgrnParallelScan)
+		PGrnParallelScanMergePendingList(pgrnParallelScan, so);
+
+	if (nOrderBys > 0)
+	{
+		int i;
+		scan->xs_orderbyvals = palloc0(sizeof(Datum) * nOrderBys);
+		scan->xs_orderbynulls = palloc(sizeof(bool) * nOrderBys);
+		for (i = 0; i < nOrderBys; i++)
+		{
+			scan->xs_orderbynulls[i] = true;
+		}
+	}
+
 	GRN_LOG(ctx, GRN_LOG_DEBUG,
 			"pgroonga: [scan][begin] <%p>",
 			so);
 
 	scan->opaque = so;
+	so->scan = scan;
 
 	return scan;
 }
@@ -6299,75 +6725,276 @@ PGrnSearchDataFree(PGrnSearchData *data)
 }
 
 static void
-PGrnSearch(IndexScanDesc scan)
+PGrnScanKeysSerialize(IndexScanDesc scan, grn_obj *buffer)
 {
-	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
-	PGrnSearchData data;
-
-	if (scan->numberOfKeys == 0)
-		return;
+	TupleDesc desc = RelationGetDescr(scan->indexRelation);
+	int i;
 
-	PGrnSearchDataInit(&data, so->index, so->sourcesTable);
-	PG_TRY();
-	{
-		PGrnSearchBuildConditions(scan, so, &data);
-	}
-	PG_CATCH();
+	GRN_BULK_REWIND(buffer);
+	for (i = 0; i < scan->numberOfKeys; i++)
 	{
-		PGrnSearchDataFree(&data);
-		PG_RE_THROW();
-	}
-	PG_END_TRY();
+		ScanKey key = &(scan->keyData[i]);
+		Oid type = key->sk_subtype;
+		int16 typeLength;
+		bool typeByValue;
+
+		GRN_TEXT_PUT(ctx, buffer, &(key->sk_attno), sizeof(AttrNumber));
+		GRN_TEXT_PUT(ctx, buffer, &(key->sk_strategy), sizeof(StrategyNumber));
+		GRN_TEXT_PUT(ctx, buffer, &(key->sk_flags), sizeof(int));
+		if (key->sk_flags & SK_ISNULL)
+			continue;
 
-	/* TODO: Add NULL check for so->searched. */
-	so->searched = grn_table_create(ctx, NULL, 0, NULL,
-									GRN_OBJ_TABLE_HASH_KEY | GRN_OBJ_WITH_SUBREC,
-									so->sourcesTable, 0);
-	if (!data.isEmptyCondition)
-	{
-		grn_table_select(ctx,
-						 so->sourcesTable,
-						 data.expression,
-						 so->searched,
-						 GRN_OP_OR);
+		if (key->sk_flags & SK_SEARCHARRAY)
+		{
+			/* sk_subtype is the element type but sk_argument is an array. */
+			typeLength = -1;
+			typeByValue = false;
+		}
+		else
+		{
+			if (!OidIsValid(type))
+				type = TupleDescAttr(desc, key->sk_attno - 1)->atttypid;
+			get_typlenbyval(type, &typeLength, &typeByValue);
+		}
+		if (typeByValue)
+		{
+			GRN_TEXT_PUT(ctx, buffer, &(key->sk_argument), sizeof(Datum));
+		}
+		else
+		{
+			GRN_TEXT_PUT(ctx,
+						 buffer,
+						 DatumGetPointer(key->sk_argument),
+						 datumGetSize(key->sk_argument,
+									  typeByValue,
+									  typeLength));
+		}
 	}
-	PGrnSearchDataFree(&data);
 }
 
-static void
-PGrnSort(IndexScanDesc scan)
+/*
+ * Searched result can be reused on rescan when scan keys aren't
+ * changed and no record is written after the search. It's common for
+ * the inner side of nested loop joins.
+ *
+ * PGrnNWrites counts only writes in this backend. Another backend may
+ * merge the pending list after the search. Merged records aren't in
+ * the searched result and they aren't collected from the pending list
+ * again. So searched result isn't reused when the index has a pending
+ * list.
+ */
+static bool
+PGrnSearchCanReuse(IndexScanDesc scan)
 {
 	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
-	ScanKey key;
-	TupleDesc desc;
-	Form_pg_attribute attribute;
-	const char *targetColumnName;
-	grn_table_sort_key sort_key;
+	grn_obj *newSearchKeys = &(buffers->general);
+	uint64_t newSearchKeysHash;
+	bool canReuse;
 
 	if (!so->searched)
-		return;
+		return false;
+	if (so->searchedNWrites != PGrnNWrites)
+		return false;
+	if (PGrnPendingListExist(so->index))
+		return false;
 
-	if (scan->numberOfKeys != 1)
-		return;
+	grn_obj_reinit(ctx, newSearchKeys, GRN_DB_TEXT, 0);
+	PGrnScanKeysSerialize(scan, newSearchKeys);
+	newSearchKeysHash = XXH64(GRN_TEXT_VALUE(newSearchKeys),
+							  GRN_TEXT_LEN(newSearchKeys),
+							  0);
+	canReuse =
+		(newSearchKeysHash == so->searchKeysHash &&
+		 GRN_TEXT_LEN(newSearchKeys) == GRN_TEXT_LEN(&(so->searchKeys)) &&
+		 memcmp(GRN_TEXT_VALUE(newSearchKeys),
+				GRN_TEXT_VALUE(&(so->searchKeys)),
+				GRN_TEXT_LEN(newSearchKeys)) == 0);
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: [search][reuse][%s] <%p>",
+			canReuse ? "yes" : "no",
+			so);
+	return canReuse;
+}
 
-	key = &(scan->keyData[0]);
-	if (!PGrnSearchIsInCondition(key))
-		return;
+static void
+PGrnSearchDataFreeCached(void *value)
+{
+	PGrnSearchData *data = value;
 
-	so->sorted = grn_table_create(ctx, NULL, 0, NULL,
-								  GRN_OBJ_TABLE_NO_KEY,
-								  NULL, so->searched);
+	PGrnSearchDataFree(data);
+	pfree(data);
+}
 
-	desc = RelationGetDescr(scan->indexRelation);
-	attribute = TupleDescAttr(desc, key->sk_attno - 1);
-	targetColumnName = attribute->attname.data;
-	sort_key.key = grn_obj_column(ctx, so->searched,
-								  targetColumnName,
-								  strlen(targetColumnName));
+/*
+ * Compiled conditions can be shared by scans for the same index with
+ * the same scan keys. Conditions for jsonb and conditions with index
+ * name or scorers aren't cached because they refer objects that
+ * aren't identified by the cache key.
+ */
+static bool
+PGrnSearchConditionIsCacheable(IndexScanDesc scan)
+{
+	TupleDesc desc = RelationGetDescr(scan->indexRelation);
+	int i;
 
-	sort_key.flags = GRN_TABLE_SORT_ASC;
-	sort_key.offset = 0;
-	grn_table_sort(ctx,
+	for (i = 0; i < scan->numberOfKeys; i++)
+	{
+		ScanKey key = &(scan->keyData[i]);
+		Form_pg_attribute attribute;
+
+		switch (key->sk_strategy)
+		{
+		case PGrnMatchConditionStrategyV2Number:
+		case PGrnQueryConditionStrategyV2Number:
+		case PGrnMatchConditionWithScorersStrategyV2Number:
+		case PGrnQueryConditionWithScorersStrategyV2Number:
+			return false;
+		default:
+			break;
+		}
+
+		attribute = TupleDescAttr(desc, key->sk_attno - 1);
+		if (PGrnAttributeIsJSONB(attribute->atttypid))
+			return false;
+	}
+
+	return true;
+}
+
+static void
+PGrnSearchConditionCacheKeyBuild(IndexScanDesc scan, grn_obj *cacheKey)
+{
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	Relation index = scan->indexRelation;
+
+	grn_obj_reinit(ctx, cacheKey, GRN_DB_TEXT, 0);
+	GRN_TEXT_PUT(ctx, cacheKey, &(index->rd_id), sizeof(Oid));
+	if (index->rd_options)
+	{
+		GRN_TEXT_PUT(ctx,
+					 cacheKey,
+					 index->rd_options,
+					 VARSIZE(index->rd_options));
+	}
+	GRN_TEXT_PUT(ctx,
+				 cacheKey,
+				 GRN_TEXT_VALUE(&(so->searchKeys)),
+				 GRN_TEXT_LEN(&(so->searchKeys)));
+}
+
+static void
+PGrnSearch(IndexScanDesc scan)
+{
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	Oid nodeID = so->index->rd_node.relNode;
+	grn_obj *cacheKey = &(buffers->general);
+	bool cacheable;
+	PGrnSearchData *cachedData = NULL;
+	PGrnSearchData data;
+
+	if (scan->numberOfKeys == 0)
+		return;
+
+	PGrnScanKeysSerialize(scan, &(so->searchKeys));
+	so->searchKeysHash = XXH64(GRN_TEXT_VALUE(&(so->searchKeys)),
+							   GRN_TEXT_LEN(&(so->searchKeys)),
+							   0);
+
+	cacheable = PGrnSearchConditionIsCacheable(scan);
+	if (cacheable)
+	{
+		PGrnSearchConditionCacheKeyBuild(scan, cacheKey);
+		cachedData = PGrnConditionCacheGet(nodeID, cacheKey);
+	}
+
+	if (cachedData)
+	{
+		PGrnAutoCloseUseIndex(so->index);
+		data = *cachedData;
+	}
+	else
+	{
+		PGrnSearchDataInit(&data, so->index, so->sourcesTable);
+		PG_TRY();
+		{
+			PGrnSearchBuildConditions(scan, so, &data);
+		}
+		PG_CATCH();
+		{
+			PGrnSearchDataFree(&data);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+	}
+
+	/* TODO: Add NULL check for so->searched. */
+	so->searched = grn_table_create(ctx, NULL, 0, NULL,
+									GRN_OBJ_TABLE_HASH_KEY | GRN_OBJ_WITH_SUBREC,
+									so->sourcesTable, 0);
+	if (!data.isEmptyCondition)
+	{
+		grn_table_select(ctx,
+						 so->sourcesTable,
+						 data.expression,
+						 so->searched,
+						 GRN_OP_OR);
+	}
+
+	if (!cachedData)
+	{
+		if (cacheable)
+		{
+			/* buffers->general may be reused while searching. */
+			PGrnSearchConditionCacheKeyBuild(scan, cacheKey);
+			cachedData = MemoryContextAlloc(TopMemoryContext,
+											sizeof(PGrnSearchData));
+			*cachedData = data;
+			cachedData->index = NULL;
+			PGrnConditionCacheAdd(nodeID, cacheKey, cachedData);
+		}
+		else
+		{
+			PGrnSearchDataFree(&data);
+		}
+	}
+
+	so->searchedNWrites = PGrnNWrites;
+}
+
+static void
+PGrnSort(IndexScanDesc scan)
+{
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	ScanKey key;
+	TupleDesc desc;
+	Form_pg_attribute attribute;
+	const char *targetColumnName;
+	grn_table_sort_key sort_key;
+
+	if (!so->searched)
+		return;
+
+	if (scan->numberOfKeys != 1)
+		return;
+
+	key = &(scan->keyData[0]);
+	if (!PGrnSearchIsInCondition(key))
+		return;
+
+	so->sorted = grn_table_create(ctx, NULL, 0, NULL,
+								  GRN_OBJ_TABLE_NO_KEY,
+								  NULL, so->searched);
+
+	desc = RelationGetDescr(scan->indexRelation);
+	attribute = TupleDescAttr(desc, key->sk_attno - 1);
+	targetColumnName = attribute->attname.data;
+	sort_key.key = grn_obj_column(ctx, so->searched,
+								  targetColumnName,
+								  strlen(targetColumnName));
+
+	sort_key.flags = GRN_TABLE_SORT_ASC;
+	sort_key.offset = 0;
+	grn_table_sort(ctx,
 				   so->searched,
 				   0,
 				   -1,
@@ -6377,6 +7004,336 @@ PGrnSort(IndexScanDesc scan)
 	grn_obj_close(ctx, sort_key.key);
 }
 
+/*
+ * We don't know LIMIT of the query. So we sort only the top N records
+ * at first and sort the next 2N records only when they are needed.
+ */
+#define PGRN_SORT_INITIAL_LIMIT 100
+
+static void
+PGrnSortByScore(IndexScanDesc scan)
+{
+	const char *tag = "[sort][score]";
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	grn_table_sort_key sortKeys[2];
+
+	if (!so->searched)
+		return;
+
+	if (so->sortLimit == 0)
+	{
+		so->sortOffset = 0;
+		so->sortLimit = PGRN_SORT_INITIAL_LIMIT;
+	}
+
+	so->sorted = grn_table_create(ctx, NULL, 0, NULL,
+								  GRN_OBJ_TABLE_NO_KEY,
+								  NULL, so->searched);
+	PGrnCheck("%s failed to create sorted table", tag);
+
+	sortKeys[0].key = grn_obj_column(ctx, so->searched,
+									 GRN_COLUMN_NAME_SCORE,
+									 GRN_COLUMN_NAME_SCORE_LEN);
+	sortKeys[0].flags = GRN_TABLE_SORT_DESC;
+	sortKeys[0].offset = 0;
+	/* Record ID is used as a tie breaker to keep windows consistent. */
+	sortKeys[1].key = grn_obj_column(ctx, so->searched,
+									 GRN_COLUMN_NAME_ID,
+									 GRN_COLUMN_NAME_ID_LEN);
+	sortKeys[1].flags = GRN_TABLE_SORT_ASC;
+	sortKeys[1].offset = 0;
+	grn_table_sort(ctx,
+				   so->searched,
+				   so->sortOffset,
+				   so->sortLimit,
+				   so->sorted,
+				   sortKeys,
+				   2);
+	grn_obj_unlink(ctx, sortKeys[0].key);
+	grn_obj_unlink(ctx, sortKeys[1].key);
+	PGrnCheck("%s failed to sort: <%d>:<%d>",
+			  tag,
+			  so->sortOffset,
+			  so->sortLimit);
+}
+
+/*
+ * PostgreSQL uses index scan for ORDER BY index columns without sort
+ * only when "<" of all index columns is a btree ordering operator.
+ */
+static bool
+PGrnIndexIsOrdered(Relation index)
+{
+	TupleDesc desc = RelationGetDescr(index);
+	int i;
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		Oid type = index->rd_opcintype[i];
+		Oid lessOperator;
+		Oid btreeOpFamily;
+		Oid btreeType;
+		int16 btreeStrategy;
+
+		lessOperator = get_opfamily_member(index->rd_opfamily[i],
+										   type,
+										   type,
+										   PGrnLessStrategyNumber);
+		if (!OidIsValid(lessOperator))
+			return false;
+		if (!get_ordering_op_properties(lessOperator,
+										&btreeOpFamily,
+										&btreeType,
+										&btreeStrategy))
+			return false;
+		if (btreeType != type || btreeStrategy != BTLessStrategyNumber)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Records are sorted by Groonga. The order matches the order of
+ * PostgreSQL only for some columns:
+ *
+ *   * Text values are sorted in byte order, not in the order of their
+ *     collation. So the column must use the "C" collation or must not
+ *     be collatable.
+ *
+ *   * NULL isn't stored in Groonga. It's sorted as 0 or an empty
+ *     string but PostgreSQL puts NULL at the end. So the column must
+ *     not have NULL. It's true for NOT NULL columns and columns that
+ *     have a scan key because all scan keys are strict.
+ */
+static bool
+PGrnIndexColumnIsSortable(Relation index, int nthAttribute, bool haveKey)
+{
+	Oid collation = index->rd_indcollation[nthAttribute];
+	AttrNumber heapAttributeNumber;
+	Relation heap;
+	bool isNotNull;
+
+	if (OidIsValid(collation) && !lc_collate_is_c(collation))
+		return false;
+
+	if (haveKey)
+		return true;
+
+	heapAttributeNumber = index->rd_index->indkey.values[nthAttribute];
+	/* Expression */
+	if (heapAttributeNumber == 0)
+		return false;
+
+	heap = RelationIdGetRelation(index->rd_index->indrelid);
+	isNotNull =
+		TupleDescAttr(RelationGetDescr(heap), heapAttributeNumber - 1)->attnotnull;
+	RelationClose(heap);
+
+	return isNotNull;
+}
+
+/*
+ * The index AM can't know whether the plan uses the order of index
+ * columns. Records are sorted for all scans that the plan may use the
+ * order. Ordered index scans that can't be sorted correctly are
+ * disabled by PGrnCostEstimateIsUnsortable(). So the plan never uses
+ * the order when the first column isn't sortable and records aren't
+ * sorted for it.
+ */
+static bool
+PGrnSortByColumnIsAvailable(IndexScanDesc scan)
+{
+	Relation index = scan->indexRelation;
+	bool haveKey = false;
+	int i;
+
+	if (scan->numberOfOrderBys > 0)
+		return false;
+
+	if (!PGrnIndexIsOrdered(index))
+		return false;
+
+	for (i = 0; i < scan->numberOfKeys; i++)
+	{
+		if (scan->keyData[i].sk_attno == 1)
+		{
+			haveKey = true;
+			break;
+		}
+	}
+
+	return PGrnIndexColumnIsSortable(index, 0, haveKey);
+}
+
+static void
+PGrnSortByColumn(IndexScanDesc scan, ScanDirection dir)
+{
+	const char *tag = "[sort][column]";
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	TupleDesc desc;
+	grn_table_sort_key *sortKeys;
+	int nSortKeys;
+	int i;
+
+	if (!so->searched)
+		return;
+
+	if (so->sortLimit == 0)
+	{
+		so->sortOffset = 0;
+		so->sortLimit = PGRN_SORT_INITIAL_LIMIT;
+	}
+
+	so->sorted = grn_table_create(ctx, NULL, 0, NULL,
+								  GRN_OBJ_TABLE_NO_KEY,
+								  NULL, so->searched);
+	PGrnCheck("%s failed to create sorted table", tag);
+
+	/* The plan may use the order of all index columns such as
+	 * ORDER BY a, b for an index of (a, b). */
+	desc = RelationGetDescr(scan->indexRelation);
+	nSortKeys = desc->natts + 1;
+	sortKeys = palloc(sizeof(grn_table_sort_key) * nSortKeys);
+	for (i = 0; i < desc->natts; i++)
+	{
+		char columnName[GRN_TABLE_MAX_KEY_SIZE];
+
+		PGrnColumnNameEncode(TupleDescAttr(desc, i)->attname.data, columnName);
+		sortKeys[i].key = grn_obj_column(ctx, so->searched,
+										 columnName,
+										 strlen(columnName));
+		/* PGrnOpenTableCursor() keeps the order of windowed records. */
+		if (ScanDirectionIsBackward(dir))
+			sortKeys[i].flags = GRN_TABLE_SORT_DESC;
+		else
+			sortKeys[i].flags = GRN_TABLE_SORT_ASC;
+		sortKeys[i].offset = 0;
+	}
+	/* Record ID is used as a tie breaker to keep windows consistent. */
+	sortKeys[i].key = grn_obj_column(ctx, so->searched,
+									 GRN_COLUMN_NAME_ID,
+									 GRN_COLUMN_NAME_ID_LEN);
+	sortKeys[i].flags = GRN_TABLE_SORT_ASC;
+	sortKeys[i].offset = 0;
+	grn_table_sort(ctx,
+				   so->searched,
+				   so->sortOffset,
+				   so->sortLimit,
+				   so->sorted,
+				   sortKeys,
+				   nSortKeys);
+	for (i = 0; i < nSortKeys; i++)
+	{
+		grn_obj_unlink(ctx, sortKeys[i].key);
+	}
+	pfree(sortKeys);
+	PGrnCheck("%s failed to sort: <%d>:<%d>",
+			  tag,
+			  so->sortOffset,
+			  so->sortLimit);
+}
+
+/*
+ * Index scan that doesn't need any order can return tuples in heap
+ * order. It makes heap access mostly sequential.
+ */
+static bool
+PGrnSortByCtidIsAvailable(IndexScanDesc scan)
+{
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+
+	if (!PGrnEnableHeapOrderScan)
+		return false;
+	if (!so->searched)
+		return false;
+	if (so->sorted)
+		return false;
+	if (scan->numberOfOrderBys > 0)
+		return false;
+	if (so->sourcesTable->header.type != GRN_TABLE_NO_KEY)
+		return false;
+	if (PGrnSortByColumnIsAvailable(scan))
+		return false;
+
+	return true;
+}
+
+static void
+PGrnSortByCtid(IndexScanDesc scan)
+{
+	const char *tag = "[sort][ctid]";
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	grn_table_sort_key sortKey;
+
+	so->sorted = grn_table_create(ctx, NULL, 0, NULL,
+								  GRN_OBJ_TABLE_NO_KEY,
+								  NULL, so->searched);
+	PGrnCheck("%s failed to create sorted table", tag);
+
+	/* Packed ctid is ordered by block number and then offset number. */
+	sortKey.key = grn_obj_column(ctx, so->searched,
+								 PGrnSourcesCtidColumnName,
+								 PGrnSourcesCtidColumnNameLength);
+	sortKey.flags = GRN_TABLE_SORT_ASC;
+	sortKey.offset = 0;
+	grn_table_sort(ctx,
+				   so->searched,
+				   0,
+				   -1,
+				   so->sorted,
+				   &sortKey,
+				   1);
+	grn_obj_unlink(ctx, sortKey.key);
+	PGrnCheck("%s failed to sort", tag);
+}
+
+static void
+PGrnOpenTableCursor(IndexScanDesc scan, ScanDirection dir);
+
+static bool
+PGrnSortNextWindow(IndexScanDesc scan, ScanDirection dir)
+{
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+
+	if (!so->sorted)
+		return false;
+	/* 0 means that all records are sorted at once. */
+	if (so->sortLimit <= 0)
+		return false;
+	if (so->sortOffset + so->sortLimit >= grn_table_size(ctx, so->searched))
+		return false;
+
+	so->sortOffset += so->sortLimit;
+	if (so->sortLimit > INT_MAX / 2)
+		so->sortLimit = -1;
+	else
+		so->sortLimit *= 2;
+
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: [sort][next-window] <%p>: <%d>:<%d>",
+			so,
+			so->sortOffset,
+			so->sortLimit);
+
+	grn_obj_unlink(ctx, so->scoreAccessor);
+	so->scoreAccessor = NULL;
+	grn_obj_unlink(ctx, so->ctidAccessor);
+	so->ctidAccessor = NULL;
+	grn_table_cursor_close(ctx, so->tableCursor);
+	so->tableCursor = NULL;
+	grn_obj_close(ctx, so->sorted);
+	so->sorted = NULL;
+
+	if (scan->numberOfOrderBys > 0)
+		PGrnSortByScore(scan);
+	else
+		PGrnSortByColumn(scan, dir);
+	PGrnOpenTableCursor(scan, dir);
+
+	return true;
+}
+
 static void
 PGrnOpenTableCursor(IndexScanDesc scan, ScanDirection dir)
 {
@@ -6393,7 +7350,8 @@ PGrnOpenTableCursor(IndexScanDesc scan, ScanDirection dir)
 	if (!table)
 		table = so->sourcesTable;
 
-	if (ScanDirectionIsBackward(dir))
+	/* Records sorted by windows are already in the scan direction. */
+	if (ScanDirectionIsBackward(dir) && !(so->sorted && so->sortLimit != 0))
 		flags |= GRN_CURSOR_DESCENDING;
 	else
 		flags |= GRN_CURSOR_ASCENDING;
@@ -6470,6 +7428,9 @@ PGrnIsMeaningfullMinBorderValue(grn_obj *currentValue,
 
 static void
 PGrnFillBorder(IndexScanDesc scan,
+			   unsigned int nthAttribute,
+			   grn_obj *minBorderValue,
+			   grn_obj *maxBorderValue,
 			   void **min, unsigned int *minSize,
 			   void **max, unsigned int *maxSize,
 			   int *flags)
@@ -6477,15 +7438,12 @@ PGrnFillBorder(IndexScanDesc scan,
 	const char *tag = "[range][fill-border]";
 	Relation index = scan->indexRelation;
 	TupleDesc desc;
-	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
-	grn_obj *minBorderValue;
-	grn_obj *maxBorderValue;
 	int i;
 
 	desc = RelationGetDescr(index);
 
-	minBorderValue = &(so->minBorderValue);
-	maxBorderValue = &(so->maxBorderValue);
+	grn_obj_reinit(ctx, minBorderValue, GRN_DB_VOID, 0);
+	grn_obj_reinit(ctx, maxBorderValue, GRN_DB_VOID, 0);
 	for (i = 0; i < scan->numberOfKeys; i++)
 	{
 		ScanKey key = &(scan->keyData[i]);
@@ -6494,6 +7452,9 @@ PGrnFillBorder(IndexScanDesc scan,
 		grn_id domain;
 
 		attrNumber = key->sk_attno - 1;
+		if (attrNumber != nthAttribute)
+			continue;
+
 		attribute = TupleDescAttr(desc, attrNumber);
 
 		domain = PGrnGetType(index, attrNumber, NULL);
@@ -6573,6 +7534,106 @@ PGrnFillBorder(IndexScanDesc scan,
 	}
 }
 
+static unsigned int
+PGrnRangeSearchLeadingAttribute(IndexScanDesc scan)
+{
+	unsigned int nthAttribute = 0;
+	int i;
+
+	for (i = 0; i < scan->numberOfKeys; i++)
+	{
+		ScanKey key = &(scan->keyData[i]);
+
+		if (i == 0 || key->sk_attno - 1 < nthAttribute)
+			nthAttribute = key->sk_attno - 1;
+	}
+
+	return nthAttribute;
+}
+
+/*
+ * Records that match range conditions for a non leading attribute are
+ * collected into so->rangeFilter. Records from the index cursor for
+ * the leading attribute are filtered by it. So the leading attribute
+ * keeps the ordered output.
+ */
+static void
+PGrnRangeSearchFilter(IndexScanDesc scan, unsigned int nthAttribute)
+{
+	const char *tag = "[range][filter]";
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	grn_obj minBorderValue;
+	grn_obj maxBorderValue;
+	void *min = NULL;
+	unsigned int minSize = 0;
+	void *max = NULL;
+	unsigned int maxSize = 0;
+	int flags = GRN_CURSOR_ASCENDING;
+	grn_obj *indexColumn;
+	grn_obj *lexicon;
+	grn_obj *filter;
+	grn_table_cursor *tableCursor;
+	grn_obj *indexCursor;
+	grn_posting *posting;
+	grn_id termID;
+
+	GRN_VOID_INIT(&minBorderValue);
+	GRN_VOID_INIT(&maxBorderValue);
+	PGrnFillBorder(scan,
+				   nthAttribute,
+				   &minBorderValue,
+				   &maxBorderValue,
+				   &min, &minSize,
+				   &max, &maxSize,
+				   &flags);
+
+	indexColumn = PGrnLookupIndexColumn(scan->indexRelation, nthAttribute,
+										ERROR);
+	lexicon = grn_column_table(ctx, indexColumn);
+
+	filter = grn_table_create(ctx, NULL, 0, NULL,
+							  GRN_OBJ_TABLE_HASH_KEY,
+							  so->sourcesTable, NULL);
+	PGrnCheck("%s failed to create filter table: <%u>", tag, nthAttribute);
+
+	tableCursor = grn_table_cursor_open(ctx, lexicon,
+										min, minSize,
+										max, maxSize,
+										0, -1, flags);
+	indexCursor = grn_index_cursor_open(ctx,
+										tableCursor, indexColumn,
+										GRN_ID_NIL,
+										GRN_ID_MAX,
+										0);
+	while ((posting = grn_index_cursor_next(ctx, indexCursor, &termID)))
+	{
+		if (so->rangeFilter &&
+			grn_table_get(ctx,
+						  so->rangeFilter,
+						  &(posting->rid),
+						  sizeof(grn_id)) == GRN_ID_NIL)
+		{
+			continue;
+		}
+		grn_table_add(ctx, filter, &(posting->rid), sizeof(grn_id), NULL);
+	}
+	grn_obj_close(ctx, indexCursor);
+	grn_table_cursor_close(ctx, tableCursor);
+	GRN_OBJ_FIN(ctx, &minBorderValue);
+	GRN_OBJ_FIN(ctx, &maxBorderValue);
+
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: %s <%p>: <%u>: <%u>",
+			tag,
+			so,
+			nthAttribute,
+			grn_table_size(ctx, filter));
+
+	if (so->rangeFilter)
+		grn_obj_close(ctx, so->rangeFilter);
+	so->rangeFilter = filter;
+}
+
 static void
 PGrnRangeSearch(IndexScanDesc scan, ScanDirection dir)
 {
@@ -6590,21 +7651,37 @@ PGrnRangeSearch(IndexScanDesc scan, ScanDirection dir)
 	grn_obj *indexColumn;
 	grn_obj *lexicon;
 	int i;
-	unsigned int nthAttribute = 0;
+	unsigned int nthAttribute;
+	bool filtered[INDEX_MAX_KEYS];
 
-	PGrnFillBorder(scan, &min, &minSize, &max, &maxSize, &flags);
+	nthAttribute = PGrnRangeSearchLeadingAttribute(scan);
+
+	memset(filtered, 0, sizeof(filtered));
+	filtered[nthAttribute] = true;
+	for (i = 0; i < scan->numberOfKeys; i++)
+	{
+		ScanKey key = &(scan->keyData[i]);
+		unsigned int keyNthAttribute = key->sk_attno - 1;
+
+		if (filtered[keyNthAttribute])
+			continue;
+		PGrnRangeSearchFilter(scan, keyNthAttribute);
+		filtered[keyNthAttribute] = true;
+	}
+
+	PGrnFillBorder(scan,
+				   nthAttribute,
+				   &(so->minBorderValue),
+				   &(so->maxBorderValue),
+				   &min, &minSize,
+				   &max, &maxSize,
+				   &flags);
 
 	if (ScanDirectionIsBackward(dir))
 		flags |= GRN_CURSOR_DESCENDING;
 	else
 		flags |= GRN_CURSOR_ASCENDING;
 
-	for (i = 0; i < scan->numberOfKeys; i++)
-	{
-		ScanKey key = &(scan->keyData[i]);
-		nthAttribute = key->sk_attno - 1;
-		break;
-	}
 	indexColumn = PGrnLookupIndexColumn(scan->indexRelation, nthAttribute,
 										ERROR);
 	lexicon = grn_column_table(ctx, indexColumn);
@@ -6636,7 +7713,6 @@ static bool
 PGrnIsRangeSearchable(IndexScanDesc scan)
 {
 	int i;
-	AttrNumber previousAttrNumber = InvalidAttrNumber;
 
 	if (scan->numberOfKeys == 0)
 	{
@@ -6666,14 +7742,9 @@ PGrnIsRangeSearchable(IndexScanDesc scan)
 	{
 		ScanKey key = &(scan->keyData[i]);
 
-		if (previousAttrNumber == InvalidAttrNumber)
-		{
-			previousAttrNumber = key->sk_attno;
-		}
-		if (key->sk_attno != previousAttrNumber)
-		{
-			return false;
-		}
+		grn_obj *indexColumn;
+		grn_obj *lexicon;
+		grn_obj *tokenizer;
 
 		switch (key->sk_strategy)
 		{
@@ -6686,11 +7757,261 @@ PGrnIsRangeSearchable(IndexScanDesc scan)
 			return false;
 			break;
 		}
+
+		/* Terms in a tokenized lexicon aren't values. */
+		indexColumn = PGrnLookupIndexColumn(scan->indexRelation,
+											key->sk_attno - 1,
+											ERROR);
+		lexicon = grn_column_table(ctx, indexColumn);
+		tokenizer = grn_obj_get_info(ctx, lexicon, GRN_INFO_DEFAULT_TOKENIZER,
+									 NULL);
+		if (tokenizer)
+			return false;
+	}
+
+	return true;
+}
+
+static grn_id
+PGrnStreamSearchLookupTerm(grn_obj *lexicon, ScanKey key)
+{
+	text *query = DatumGetTextPP(key->sk_argument);
+	grn_token_cursor *tokenCursor;
+	grn_id termID = GRN_ID_NIL;
+	int nTokens = 0;
+	bool forcePrefixSearch = false;
+
+	tokenCursor = grn_token_cursor_open(ctx,
+										lexicon,
+										VARDATA_ANY(query),
+										VARSIZE_ANY_EXHDR(query),
+										GRN_TOKEN_GET,
+										0);
+	if (!tokenCursor)
+	{
+		ctx->rc = GRN_SUCCESS;
+		return GRN_ID_NIL;
+	}
+	while (grn_token_cursor_get_status(ctx, tokenCursor) ==
+		   GRN_TOKEN_CURSOR_DOING)
+	{
+		grn_id id = grn_token_cursor_next(ctx, tokenCursor);
+		grn_token *token = grn_token_cursor_get_token(ctx, tokenCursor);
+
+		nTokens++;
+		if (nTokens > 1)
+			break;
+		termID = id;
+		forcePrefixSearch = grn_token_get_force_prefix_search(ctx, token);
+	}
+	grn_token_cursor_close(ctx, tokenCursor);
+
+	if (nTokens != 1)
+		return GRN_ID_NIL;
+	if (forcePrefixSearch)
+		return GRN_ID_NIL;
+
+	return termID;
+}
+
+/*
+ * A single term &@ without sort can be processed by reading the
+ * posting list of the term directly. We don't need to materialize all
+ * hits. Score is computed lazily by PGrnStreamSearchPrepareScore()
+ * only when it's requested.
+ */
+static bool
+PGrnStreamSearch(IndexScanDesc scan)
+{
+	const char *tag = "[stream-search]";
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	ScanKey key;
+	TupleDesc desc;
+	Form_pg_attribute attribute;
+	grn_obj *indexColumn;
+	grn_obj *lexicon;
+	grn_id termID;
+	int threshold;
+
+	if (scan->numberOfKeys != 1)
+		return false;
+	if (scan->numberOfOrderBys > 0)
+		return false;
+
+	key = &(scan->keyData[0]);
+	if (key->sk_flags & (SK_ISNULL | SK_SEARCHARRAY))
+		return false;
+	switch (key->sk_strategy)
+	{
+	case PGrnMatchStrategyNumber:
+	case PGrnMatchStrategyV2Number:
+		break;
+	default:
+		return false;
+	}
+
+	desc = RelationGetDescr(scan->indexRelation);
+	attribute = TupleDescAttr(desc, key->sk_attno - 1);
+	switch (attribute->atttypid)
+	{
+	case TEXTOID:
+	case VARCHAROID:
+		break;
+	default:
+		return false;
+	}
+
+	indexColumn = PGrnLookupIndexColumn(scan->indexRelation,
+										key->sk_attno - 1,
+										ERROR);
+	lexicon = grn_column_table(ctx, indexColumn);
+	if (!grn_obj_get_info(ctx, lexicon, GRN_INFO_DEFAULT_TOKENIZER, NULL))
+		return false;
+
+	if (grn_ctx_get_force_match_escalation(ctx))
+		return false;
+
+	/* Unknown term may be escalated to loose search. */
+	termID = PGrnStreamSearchLookupTerm(lexicon, key);
+	if (termID == GRN_ID_NIL)
+		return false;
+
+	/* Loose search is used when the number of hits <= threshold. */
+	threshold = grn_ctx_get_match_escalation_threshold(ctx);
+	if (threshold >= 0)
+	{
+		grn_ii_cursor *iiCursor;
+		int nPostings = 0;
+
+		iiCursor = grn_ii_cursor_open(ctx,
+									  (grn_ii *) indexColumn,
+									  termID,
+									  GRN_ID_NIL,
+									  GRN_ID_MAX,
+									  grn_ii_get_n_elements(ctx,
+															(grn_ii *) indexColumn),
+									  0);
+		if (!iiCursor)
+			return false;
+		while (nPostings <= threshold && grn_ii_cursor_next(ctx, iiCursor))
+		{
+			nPostings++;
+		}
+		grn_ii_cursor_close(ctx, iiCursor);
+		if (nPostings <= threshold)
+			return false;
+	}
+
+	so->iiCursor = grn_ii_cursor_open(ctx,
+									  (grn_ii *) indexColumn,
+									  termID,
+									  GRN_ID_NIL,
+									  GRN_ID_MAX,
+									  grn_ii_get_n_elements(ctx,
+															(grn_ii *) indexColumn),
+									  0);
+	if (!so->iiCursor)
+	{
+		PGrnCheck("%s failed to open posting list cursor", tag);
+		return false;
+	}
+	if (so->sourcesTable->header.type == GRN_TABLE_NO_KEY)
+	{
+		so->ctidAccessor = grn_obj_column(ctx, so->sourcesTable,
+										  PGrnSourcesCtidColumnName,
+										  PGrnSourcesCtidColumnNameLength);
+	}
+	else
+	{
+		so->ctidAccessor = grn_obj_column(ctx, so->sourcesTable,
+										  GRN_COLUMN_NAME_KEY,
+										  GRN_COLUMN_NAME_KEY_LEN);
 	}
 
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: %s <%s>(%u): <%u>",
+			tag,
+			scan->indexRelation->rd_rel->relname.data,
+			scan->indexRelation->rd_id,
+			termID);
+
 	return true;
 }
 
+static void
+PGrnStreamSearchPrepareScore(PGrnScanOpaque so)
+{
+	if (!so->iiCursor)
+		return;
+	if (so->searched)
+		return;
+
+	PGrnSearch(so->scan);
+	so->scoreAccessor = grn_obj_column(ctx, so->searched,
+									   GRN_COLUMN_NAME_SCORE,
+									   GRN_COLUMN_NAME_SCORE_LEN);
+}
+
+/*
+ * Pending records aren't searched by Groonga. Plain index scan returns
+ * them after searched records with recheck like bitmap scan. So it
+ * doesn't write to Groonga. Scores, index only scan and ordered
+ * results need values in the sources table. Pending records are
+ * merged for them.
+ */
+static void
+PGrnPreparePendingList(IndexScanDesc scan)
+{
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+
+	if (so->pendingCtidsCollected)
+		return;
+	so->pendingCtidsCollected = true;
+
+	if (scan->parallel_scan)
+	{
+		if (PGrnParallelScanIsPendingListMerged(scan))
+			return;
+		/* Other participants return no record. */
+		if (!PGrnParallelScanOwnAll(scan))
+			return;
+	}
+
+	/* Pending records must be collected before searching. They may be
+	 * merged by another backend while searching. */
+	if (PGrnPendingListCollectCtids(so->index, &(so->pendingCtids)) == 0)
+		return;
+
+	if (scan->numberOfOrderBys == 0 &&
+		!scan->xs_want_itup &&
+		!PGrnSortByColumnIsAvailable(scan))
+		return;
+
+	/* Pending records aren't merged in parallel scan only when
+	 * pgroonga.writable is false. Workers never merge them. */
+	if (scan->parallel_scan || !PGrnIsWritable())
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_E_MODIFYING_SQL_DATA_NOT_PERMITTED),
+				 errmsg("pgroonga: [scan][pending-list] "
+						"can't merge pending records for "
+						"ordered or index only scan "
+						"while pgroonga.writable is false: <%s>",
+						RelationGetRelationName(so->index))));
+	}
+
+	GRN_BULK_REWIND(&(so->pendingCtids));
+	if (PGrnPendingListMerge(so->index) > 0)
+	{
+		PGrnNWrites++;
+		if (so->searched)
+		{
+			grn_obj_close(ctx, so->searched);
+			so->searched = NULL;
+		}
+	}
+}
+
 static void
 PGrnEnsureCursorOpened(IndexScanDesc scan,
 					   ScanDirection dir,
@@ -6716,22 +8037,78 @@ PGrnEnsureCursorOpened(IndexScanDesc scan,
 
 	if (so->indexCursor)
 		return;
+	if (so->iiCursor)
+		return;
 	if (so->tableCursor)
 		return;
 
-	if (PGrnIsRangeSearchable(scan))
+	/* Bitmap scan collects pending records by itself. */
+	if (needSort)
+		PGrnPreparePendingList(scan);
+
+	if (scan->numberOfOrderBys == 0 &&
+		PGrnIsRangeSearchable(scan) &&
+		!(needSort &&
+		  PGrnSortByColumnIsAvailable(scan) &&
+		  PGrnRangeSearchLeadingAttribute(scan) != 0))
 	{
 		PGrnRangeSearch(scan, dir);
 	}
+	else if (!(needSort && (PGrnSortByColumnIsAvailable(scan) ||
+							 PGrnEnableHeapOrderScan)) &&
+			 PGrnStreamSearch(scan))
+	{
+		/* Posting list is read in get tuple/bitmap directly. */
+	}
 	else
 	{
-		PGrnSearch(scan);
-		if (needSort)
+		if (!so->searched)
+			PGrnSearch(scan);
+		if (scan->numberOfOrderBys > 0)
+			PGrnSortByScore(scan);
+		else if (needSort && PGrnSortByColumnIsAvailable(scan))
+			PGrnSortByColumn(scan, dir);
+		else if (needSort)
 			PGrnSort(scan);
+		if (needSort && PGrnSortByCtidIsAvailable(scan))
+			PGrnSortByCtid(scan);
 		PGrnOpenTableCursor(scan, dir);
 	}
 }
 
+static grn_id
+PGrnScanOpaqueNextPostingRecordID(PGrnScanOpaque so)
+{
+	grn_posting *posting;
+
+	if (so->iiCursor)
+	{
+		posting = grn_ii_cursor_next(ctx, so->iiCursor);
+	}
+	else
+	{
+		grn_id termID;
+
+		while ((posting = grn_index_cursor_next(ctx,
+												so->indexCursor,
+												&termID)))
+		{
+			if (!so->rangeFilter)
+				break;
+			if (grn_table_get(ctx,
+							  so->rangeFilter,
+							  &(posting->rid),
+							  sizeof(grn_id)) != GRN_ID_NIL)
+				break;
+		}
+	}
+
+	if (!posting)
+		return GRN_ID_NIL;
+
+	return posting->rid;
+}
+
 static grn_id
 PGrnScanOpaqueResolveID(PGrnScanOpaque so)
 {
@@ -6743,7 +8120,8 @@ PGrnScanOpaqueResolveID(PGrnScanOpaque so)
 		grn_obj_get_value(ctx, so->sorted, recordID, &(buffers->general));
 		recordID = GRN_RECORD_VALUE(&(buffers->general));
 	}
-	if (so->searched)
+	/* so->searched may be created only for score with stream search. */
+	if (so->searched && !so->iiCursor)
 	{
 		grn_table_get_key(ctx, so->searched, recordID,
 						  &recordID, sizeof(grn_id));
@@ -6752,6 +8130,69 @@ PGrnScanOpaqueResolveID(PGrnScanOpaque so)
 	return recordID;
 }
 
+static double
+PGrnScanOpaqueGetScore(PGrnScanOpaque so)
+{
+	grn_id recordID = so->currentID;
+
+	if (!so->scoreAccessor)
+		return 0.0;
+
+	if (so->sorted)
+	{
+		GRN_BULK_REWIND(&(buffers->general));
+		grn_obj_get_value(ctx, so->sorted, recordID, &(buffers->general));
+		recordID = GRN_RECORD_VALUE(&(buffers->general));
+	}
+
+	GRN_BULK_REWIND(&(buffers->score));
+	grn_obj_get_value(ctx, so->scoreAccessor, recordID, &(buffers->score));
+	if (buffers->score.header.domain == GRN_DB_FLOAT)
+	{
+		return GRN_FLOAT_VALUE(&(buffers->score));
+	}
+	else
+	{
+		return GRN_INT32_VALUE(&(buffers->score));
+	}
+}
+
+/*
+ * The ORDER BY key is <&@~>. It's the distance by score. So the most
+ * relevant record has the smallest value. See also
+ * PGrnScanOpaqueInitOrderBys().
+ */
+static void
+PGrnGetTupleFillOrderByValues(PGrnScanOpaque so,
+							  IndexScanDesc scan)
+{
+	double score;
+	int i;
+
+	score = PGrnScanOpaqueGetScore(so);
+	for (i = 0; i < scan->numberOfOrderBys; i++)
+	{
+		ScanKey orderBy = &(scan->orderByData[i]);
+
+		if (orderBy->sk_flags & SK_ISNULL)
+		{
+			scan->xs_orderbyvals[i] = (Datum) 0;
+			scan->xs_orderbynulls[i] = true;
+		}
+		else if (GRN_BOOL_VALUE_AT(&(so->orderByIsScores), i))
+		{
+			scan->xs_orderbyvals[i] = Float8GetDatum(-score);
+			scan->xs_orderbynulls[i] = false;
+		}
+		else
+		{
+			scan->xs_orderbyvals[i] = Float8GetDatum(0.0);
+			scan->xs_orderbynulls[i] = false;
+		}
+	}
+	scan->xs_recheckorderby = false;
+}
+
 static bool pgroonga_canreturn_raw(Relation index, int nthAttribute);
 
 static void
@@ -6816,6 +8257,24 @@ PGrnGetTupleFillIndexTuple(PGrnScanOpaque so,
 	MemoryContextSwitchTo(oldMemoryContext);
 }
 
+static bool
+PGrnGetTupleNextPendingCtid(PGrnScanOpaque so,
+							IndexScanDesc scan)
+{
+	ItemPointerData ctid;
+
+	if (so->pendingCtidsOffset >=
+		GRN_BULK_VSIZE(&(so->pendingCtids)) / sizeof(uint64))
+		return false;
+
+	ctid = PGrnCtidUnpack(GRN_UINT64_VALUE_AT(&(so->pendingCtids),
+											  so->pendingCtidsOffset));
+	so->pendingCtidsOffset++;
+	scan->xs_recheck = true;
+	PGRN_INDEX_SCAN_DESC_SET_FOUND_CTID(scan, ctid);
+	return true;
+}
+
 static bool
 pgroonga_gettuple_internal(IndexScanDesc scan,
 						   ScanDirection direction)
@@ -6824,12 +8283,6 @@ pgroonga_gettuple_internal(IndexScanDesc scan,
 	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
 	bool found = false;
 
-	if (scan->parallel_scan)
-	{
-		if (!PGrnParallelScanAcquire(scan))
-			return false;
-	}
-
 	PGrnEnsureCursorOpened(scan, direction, true);
 
 	if (scan->kill_prior_tuple &&
@@ -6889,15 +8342,9 @@ pgroonga_gettuple_internal(IndexScanDesc scan,
 
 	while (!found)
 	{
-		if (so->indexCursor)
+		if (so->indexCursor || so->iiCursor)
 		{
-			grn_posting *posting;
-			grn_id termID;
-			grn_id id = GRN_ID_NIL;
-			posting = grn_index_cursor_next(ctx, so->indexCursor, &termID);
-			if (posting)
-				id = posting->rid;
-			so->currentID = id;
+			so->currentID = PGrnScanOpaqueNextPostingRecordID(so);
 		}
 		else
 		{
@@ -6905,7 +8352,15 @@ pgroonga_gettuple_internal(IndexScanDesc scan,
 		}
 
 		if (so->currentID == GRN_ID_NIL)
+		{
+			if (PGrnSortNextWindow(scan, direction))
+				continue;
 			break;
+		}
+
+		if (scan->parallel_scan &&
+			!PGrnParallelScanOwn(scan, PGrnScanOpaqueResolveID(so)))
+			continue;
 
 		{
 			uint64 packedCtid;
@@ -6957,15 +8412,25 @@ pgroonga_gettuple_internal(IndexScanDesc scan,
 			if (!valid)
 				continue;
 
+			/* It's returned with other pending records. */
+			if (PGrnPendingListCtidsContain(&(so->pendingCtids), packedCtid))
+				continue;
+
 			PGRN_INDEX_SCAN_DESC_SET_FOUND_CTID(scan, ctid);
 		}
 
 		if (scan->xs_want_itup)
 			PGrnGetTupleFillIndexTuple(so, scan);
 
+		if (scan->numberOfOrderBys > 0)
+			PGrnGetTupleFillOrderByValues(so, scan);
+
 		found = true;
 	}
 
+	if (!found)
+		found = PGrnGetTupleNextPendingCtid(so, scan);
+
 	return found;
 }
 
@@ -7001,38 +8466,237 @@ pgroonga_gettuple(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(found);
 }
 
+/* 8192 * (sizeof(uint64) + sizeof(ItemPointerData)) = 112KiB */
+#define PGRN_GET_BITMAP_BATCH_SIZE 8192
+
+typedef struct PGrnGetBitmapBatch
+{
+	TIDBitmap *tbm;
+	bool recheck;
+	bool lossy;
+	uint64 *packedCtids;
+	ItemPointerData *ctids;
+	int nPackedCtids;
+	int64 nRecords;
+} PGrnGetBitmapBatch;
+
+static int
+PGrnGetBitmapComparePackedCtid(const void *a, const void *b)
+{
+	uint64 packedCtidA = *((const uint64 *) a);
+	uint64 packedCtidB = *((const uint64 *) b);
+
+	if (packedCtidA < packedCtidB)
+		return -1;
+	else if (packedCtidA > packedCtidB)
+		return 1;
+	else
+		return 0;
+}
+
+static void
+PGrnGetBitmapBatchInit(PGrnGetBitmapBatch *batch,
+					   TIDBitmap *tbm,
+					   bool recheck,
+					   bool lossy)
+{
+	batch->tbm = tbm;
+	batch->recheck = recheck;
+	batch->lossy = lossy;
+	batch->packedCtids = palloc(sizeof(uint64) * PGRN_GET_BITMAP_BATCH_SIZE);
+	batch->ctids = palloc(sizeof(ItemPointerData) * PGRN_GET_BITMAP_BATCH_SIZE);
+	batch->nPackedCtids = 0;
+	batch->nRecords = 0;
+}
+
+static void
+PGrnGetBitmapBatchFin(PGrnGetBitmapBatch *batch)
+{
+	pfree(batch->packedCtids);
+	pfree(batch->ctids);
+}
+
+/*
+ * Packed ctid is (block << 16) + offset. So sorted packed ctids are
+ * grouped by block. We can add all tuples in the same block by one
+ * tbm_add_tuples() call.
+ */
+static void
+PGrnGetBitmapBatchFlush(PGrnGetBitmapBatch *batch)
+{
+	int i;
+	int nCtids = 0;
+	BlockNumber currentBlock = InvalidBlockNumber;
+
+	if (batch->nPackedCtids == 0)
+		return;
+
+	qsort(batch->packedCtids,
+		  batch->nPackedCtids,
+		  sizeof(uint64),
+		  PGrnGetBitmapComparePackedCtid);
+
+	for (i = 0; i < batch->nPackedCtids; i++)
+	{
+		ItemPointerData ctid = PGrnCtidUnpack(batch->packedCtids[i]);
+		BlockNumber block;
+
+		if (!ItemPointerIsValid(&ctid))
+			continue;
+
+		block = ItemPointerGetBlockNumber(&ctid);
+		if (batch->lossy)
+		{
+			if (block != currentBlock)
+				tbm_add_page(batch->tbm, block);
+			currentBlock = block;
+			batch->nRecords++;
+			continue;
+		}
+		if (nCtids > 0 && block != currentBlock)
+		{
+			tbm_add_tuples(batch->tbm, batch->ctids, nCtids, batch->recheck);
+			batch->nRecords += nCtids;
+			nCtids = 0;
+		}
+		currentBlock = block;
+		batch->ctids[nCtids++] = ctid;
+	}
+	if (nCtids > 0)
+	{
+		tbm_add_tuples(batch->tbm, batch->ctids, nCtids, batch->recheck);
+		batch->nRecords += nCtids;
+	}
+
+	batch->nPackedCtids = 0;
+}
+
+static void
+PGrnGetBitmapBatchAdd(PGrnGetBitmapBatch *batch, uint64 packedCtid)
+{
+	batch->packedCtids[batch->nPackedCtids++] = packedCtid;
+	if (batch->nPackedCtids == PGRN_GET_BITMAP_BATCH_SIZE)
+		PGrnGetBitmapBatchFlush(batch);
+}
+
+/*
+ * TID bitmap has an exact page entry for each heap block and
+ * work_mem limits the number of entries. If the hits are spread over
+ * more heap blocks than the limit, TID bitmap will be lossy soon. We
+ * add lossy pages directly for the case. Heap recheck is done for
+ * lossy pages.
+ */
+static bool
+PGrnGetBitmapNeedLossy(PGrnScanOpaque so)
+{
+#ifdef PGRN_HAVE_TBM_CALCULATE_ENTRIES
+	grn_obj *table;
+	unsigned int nHits;
+	long maxEntries;
+	Relation heap;
+	BlockNumber nHeapBlocks;
+	double nBlocks;
+
+	if (so->indexCursor || so->iiCursor)
+		return false;
+
+	table = so->searched;
+	if (!table)
+		table = so->sourcesTable;
+	nHits = grn_table_size(ctx, table);
+	maxEntries = tbm_calculate_entries(work_mem * 1024L);
+	if (nHits <= maxEntries)
+		return false;
+
+	heap = RelationIdGetRelation(so->dataTableID);
+	nHeapBlocks = RelationGetNumberOfBlocks(heap);
+	RelationClose(heap);
+	if (nHeapBlocks <= maxEntries)
+		return false;
+
+	/* The expected number of distinct heap blocks when the hits are
+	 * spread uniformly. */
+	nBlocks = nHeapBlocks * (1.0 - pow(1.0 - 1.0 / nHeapBlocks, nHits));
+	if (nBlocks <= maxEntries)
+		return false;
+
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: [get-bitmap][lossy] <%s>(%u): <%u>: <%.0f> > <%ld>",
+			so->index->rd_rel->relname.data,
+			so->index->rd_id,
+			nHits,
+			nBlocks,
+			maxEntries);
+	return true;
+#else
+	return false;
+#endif
+}
+
+static bool
+PGrnGetBitmapResolvePackedCtid(PGrnScanOpaque so,
+							   grn_column_cache *sourcesCtidColumnCache,
+							   grn_id sourceID,
+							   uint64 *packedCtid)
+{
+	if (sourcesCtidColumnCache)
+	{
+		void *value;
+		size_t valueSize;
+
+		value = grn_column_cache_ref(ctx,
+									 sourcesCtidColumnCache,
+									 sourceID,
+									 &valueSize);
+		if (valueSize != sizeof(uint64))
+			return false;
+		*packedCtid = *((uint64 *) value);
+		return true;
+	}
+
+	return PGrnScanOpaqueResolvePackedCtid(so, sourceID, packedCtid);
+}
+
 static int64
 pgroonga_getbitmap_internal(IndexScanDesc scan,
 							TIDBitmap *tbm)
 {
 	const char *tag = "pgroonga: [get-bitmap]";
 	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
-	int64 nRecords = 0;
+	PGrnGetBitmapBatch batch;
+	grn_column_cache *sourcesCtidColumnCache = NULL;
+	int64 nPendingRecords;
 
-	if (scan->parallel_scan)
-	{
-		if (!PGrnParallelScanAcquire(scan))
-			return 0;
-	}
+	/* Pending records must be collected before searching. They may be
+	 * merged by another backend while searching. */
+	nPendingRecords = PGrnPendingListGetBitmap(so->index, tbm);
 
 	PGrnEnsureCursorOpened(scan, ForwardScanDirection, false);
 
-	if (so->indexCursor)
+	PGrnGetBitmapBatchInit(&batch,
+						   tbm,
+						   scan->xs_recheck,
+						   PGrnGetBitmapNeedLossy(so));
+	if (so->sourcesCtidColumn)
+		sourcesCtidColumnCache =
+			grn_column_cache_open(ctx, so->sourcesCtidColumn);
+
+	if (so->indexCursor || so->iiCursor)
 	{
-		grn_posting *posting;
-		grn_id termID;
-		while ((posting = grn_index_cursor_next(ctx, so->indexCursor, &termID)))
+		while (true)
 		{
 			uint64 packedCtid;
-			ItemPointerData ctid;
 
-			so->currentID = posting->rid;
-			GRN_BULK_REWIND(&(buffers->ctid));
-			grn_obj_get_value(ctx,
-							  so->ctidAccessor,
-							  so->currentID,
-							  &(buffers->ctid));
-			if (GRN_BULK_VSIZE(&(buffers->ctid)) == 0)
+			so->currentID = PGrnScanOpaqueNextPostingRecordID(so);
+			if (so->currentID == GRN_ID_NIL)
+				break;
+			if (scan->parallel_scan &&
+				!PGrnParallelScanOwn(scan, so->currentID))
+				continue;
+			if (!PGrnGetBitmapResolvePackedCtid(so,
+												sourcesCtidColumnCache,
+												so->currentID,
+												&packedCtid))
 			{
 				GRN_LOG(ctx,
 						GRN_LOG_DEBUG,
@@ -7043,42 +8707,41 @@ pgroonga_getbitmap_internal(IndexScanDesc scan,
 						so->currentID);
 				continue;
 			}
-
-			packedCtid = GRN_UINT64_VALUE(&(buffers->ctid));
-			ctid = PGrnCtidUnpack(packedCtid);
-			GRN_LOG(ctx, GRN_LOG_DEBUG,
-					"%s[index-cursor] <%s>(%u): <%u>: <(%u,%u),%u>(%" PRIu64 ")",
-					tag,
-					so->index->rd_rel->relname.data,
-					so->index->rd_id,
-					so->currentID,
-					ctid.ip_blkid.bi_hi,
-					ctid.ip_blkid.bi_lo,
-					ctid.ip_posid,
-					packedCtid);
-			if (!ItemPointerIsValid(&ctid))
-				continue;
-			tbm_add_tuples(tbm, &ctid, 1, scan->xs_recheck);
-			nRecords++;
+			PGrnGetBitmapBatchAdd(&batch, packedCtid);
 		}
 	}
 	else
 	{
+		/* Bitmap scan never sorts. So the cursor is for searched or sources. */
+		bool useSearched = (so->searched != NULL);
 		while (true)
 		{
+			grn_id sourceID;
 			uint64 packedCtid;
-			ItemPointerData ctid;
 
 			so->currentID = grn_table_cursor_next(ctx, so->tableCursor);
 			if (so->currentID == GRN_ID_NIL)
 				break;
 
-			GRN_BULK_REWIND(&(buffers->ctid));
-			grn_obj_get_value(ctx,
-							  so->ctidAccessor,
-							  so->currentID,
-							  &(buffers->ctid));
-			if (GRN_BULK_VSIZE(&(buffers->ctid)) == 0)
+			if (useSearched)
+			{
+				void *key;
+				grn_table_cursor_get_key(ctx, so->tableCursor, &key);
+				sourceID = *((grn_id *) key);
+			}
+			else
+			{
+				sourceID = so->currentID;
+			}
+
+			if (scan->parallel_scan &&
+				!PGrnParallelScanOwn(scan, sourceID))
+				continue;
+
+			if (!PGrnGetBitmapResolvePackedCtid(so,
+												sourcesCtidColumnCache,
+												sourceID,
+												&packedCtid))
 			{
 				GRN_LOG(ctx,
 						GRN_LOG_DEBUG,
@@ -7086,30 +8749,27 @@ pgroonga_getbitmap_internal(IndexScanDesc scan,
 						tag,
 						so->index->rd_rel->relname.data,
 						so->index->rd_id,
-						PGrnScanOpaqueResolveID(so));
+						sourceID);
 				continue;
 			}
-
-			packedCtid = GRN_UINT64_VALUE(&(buffers->ctid));
-			ctid = PGrnCtidUnpack(packedCtid);
-			GRN_LOG(ctx, GRN_LOG_DEBUG,
-					"%s <%s>(%u): <%u>: <(%u,%u),%u>(%" PRIu64 ")",
-					tag,
-					so->index->rd_rel->relname.data,
-					so->index->rd_id,
-					PGrnScanOpaqueResolveID(so),
-					ctid.ip_blkid.bi_hi,
-					ctid.ip_blkid.bi_lo,
-					ctid.ip_posid,
-					packedCtid);
-			if (!ItemPointerIsValid(&ctid))
-				continue;
-			tbm_add_tuples(tbm, &ctid, 1, scan->xs_recheck);
-			nRecords++;
+			PGrnGetBitmapBatchAdd(&batch, packedCtid);
 		}
 	}
+	PGrnGetBitmapBatchFlush(&batch);
 
-	return nRecords;
+	if (sourcesCtidColumnCache)
+		grn_column_cache_close(ctx, sourcesCtidColumnCache);
+	PGrnGetBitmapBatchFin(&batch);
+
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"%s <%s>(%u): <%" PRId64 ">: <%" PRId64 ">",
+			tag,
+			so->index->rd_rel->relname.data,
+			so->index->rd_id,
+			batch.nRecords,
+			nPendingRecords);
+
+	return batch.nRecords + nPendingRecords;
 }
 
 static int64
@@ -7145,6 +8805,65 @@ pgroonga_getbitmap(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(nRecords);
 }
 
+static bool
+PGrnScanOpaqueOrderByIsScore(IndexScanDesc scan, ScanKey orderBy)
+{
+	text *orderByQuery;
+	int i;
+
+	if (orderBy->sk_flags & SK_ISNULL)
+		return false;
+
+	orderByQuery = DatumGetTextPP(orderBy->sk_argument);
+	for (i = 0; i < scan->numberOfKeys; i++)
+	{
+		ScanKey key = &(scan->keyData[i]);
+		text *query;
+
+		if (key->sk_attno != orderBy->sk_attno)
+			continue;
+		if (key->sk_strategy != PGrnQueryStrategyV2Number)
+			continue;
+		if (key->sk_flags & SK_ISNULL)
+			continue;
+
+		query = DatumGetTextPP(key->sk_argument);
+		if (VARSIZE_ANY_EXHDR(query) != VARSIZE_ANY_EXHDR(orderByQuery))
+			continue;
+		if (memcmp(VARDATA_ANY(query),
+				   VARDATA_ANY(orderByQuery),
+				   VARSIZE_ANY_EXHDR(query)) != 0)
+			continue;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * The value of <&@~> is the score of the current search only when its
+ * query is searched by &@~ in WHERE. Otherwise the score can't be
+ * computed. The value is a constant 0 like
+ * pgroonga_query_score_distance_text() for sequential scan. So the
+ * query doesn't fail by plan.
+ */
+static void
+PGrnScanOpaqueInitOrderBys(IndexScanDesc scan)
+{
+	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
+	int i;
+
+	GRN_BULK_REWIND(&(so->orderByIsScores));
+	for (i = 0; i < scan->numberOfOrderBys; i++)
+	{
+		ScanKey orderBy = &(scan->orderByData[i]);
+
+		GRN_BOOL_PUT(ctx,
+					 &(so->orderByIsScores),
+					 PGrnScanOpaqueOrderByIsScore(scan, orderBy));
+	}
+}
+
 static void
 pgroonga_rescan_raw(IndexScanDesc scan,
 					ScanKey keys,
@@ -7155,10 +8874,20 @@ pgroonga_rescan_raw(IndexScanDesc scan,
 	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
 
 	MemoryContextReset(so->memoryContext);
-	PGrnScanOpaqueReinit(so);
 
 	if (keys && scan->numberOfKeys > 0)
 		memmove(scan->keyData, keys, scan->numberOfKeys * sizeof(ScanKeyData));
+	if (orderBys && scan->numberOfOrderBys > 0)
+		memmove(scan->orderByData,
+				orderBys,
+				scan->numberOfOrderBys * sizeof(ScanKeyData));
+
+	PGrnScanOpaqueInitOrderBys(scan);
+
+	if (PGrnSearchCanReuse(scan))
+		PGrnScanOpaqueReinitCursor(so);
+	else
+		PGrnScanOpaqueReinit(so);
 }
 
 /**
@@ -7202,9 +8931,46 @@ pgroonga_endscan(PG_FUNCTION_ARGS)
 {
 	IndexScanDesc scan = (IndexScanDesc) PG_GETARG_POINTER(0);
 
-	pgroonga_endscan_raw(scan);
+	pgroonga_endscan_raw(scan);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Sub phases reported to pg_stat_progress_create_index. 1 is reserved
+ * by PostgreSQL for "initializing".
+ */
+#define PGRN_BUILD_PHASE_SCAN_HEAP 2
+#define PGRN_BUILD_PHASE_SET_SOURCES 3
+#define PGRN_BUILD_PHASE_FINISH_SOURCES_TABLE 4
+#define PGRN_BUILD_PHASE_UPDATE_MAX_RECORD_SIZE 5
+
+static void
+PGrnBuildProgressSetPhase(int64 phase)
+{
+#ifdef PGRN_SUPPORT_PROGRESS
+	pgstat_progress_update_param(PROGRESS_CREATEIDX_SUBPHASE, phase);
+#endif
+}
 
-	PG_RETURN_VOID();
+static void
+PGrnBuildProgressSetNTuples(double nTuples, bool isTotal)
+{
+#ifdef PGRN_SUPPORT_PROGRESS
+	if (isTotal)
+	{
+		const int indexes[] = {
+			PROGRESS_CREATEIDX_TUPLES_TOTAL,
+			PROGRESS_CREATEIDX_TUPLES_DONE,
+		};
+		const int64 values[] = {nTuples, nTuples};
+		pgstat_progress_update_multi_param(lengthof(indexes), indexes, values);
+	}
+	else
+	{
+		pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_DONE, nTuples);
+	}
+#endif
 }
 
 static void
@@ -7231,23 +8997,301 @@ PGrnBuildCallback(Relation index,
 
 	oldMemoryContext = MemoryContextSwitchTo(bs->memoryContext);
 
+	if (bs->insertLock)
+		LWLockAcquire(bs->insertLock, LW_EXCLUSIVE);
 	recordSize = PGrnInsert(index,
-							bs->sourcesTable,
-							bs->sourcesCtidColumn,
+							&(bs->target),
 							values,
 							isnull,
 							tid);
+	if (bs->insertLock)
+		LWLockRelease(bs->insertLock);
 	if (bs->needMaxRecordSizeUpdate &&
 		recordSize > bs->maxRecordSize)
 	{
 		bs->maxRecordSize = recordSize;
 	}
 	bs->nIndexedTuples++;
+	if (bs->reportProgress)
+		PGrnBuildProgressSetNTuples(bs->nIndexedTuples, false);
 
 	MemoryContextSwitchTo(oldMemoryContext);
+#ifdef PGRN_HAVE_MEMORY_CONTEXT_MEM_ALLOCATED
+	/* Temporary memory is released only when it reaches
+	 * maintenance_work_mem. Resetting for each tuple is slow. */
+	if (MemoryContextMemAllocated(bs->memoryContext, true) < bs->workMemSize)
+		return;
+#endif
 	MemoryContextReset(bs->memoryContext);
 }
 
+#ifdef PGRN_SUPPORT_PARALLEL_BUILD
+/*
+ * Parallel index build scans the heap by the leader and workers. All
+ * of them insert records into the building sources table. Groonga
+ * doesn't serialize writes to columns by multiple processes. So
+ * insertions are serialized by insertLock in the shared memory.
+ * Heap scan and visibility check are still done in parallel. Index
+ * columns are built by the leader after all records are inserted.
+ */
+#define PGRN_BUILD_SHARED_KEY UINT64CONST(0xA000000000000001)
+#define PGRN_BUILD_LOCK_TRANCHE_NAME "pgroonga_build"
+
+typedef struct PGrnBuildSharedData
+{
+	LWLock insertLock;
+	int insertLockTrancheID;
+	Oid heapID;
+	Oid indexID;
+	bool isConcurrent;
+	slock_t mutex;
+	double nHeapTuples;
+	double nIndexedTuples;
+	uint32_t maxRecordSize;
+	Size workMemSize;
+} PGrnBuildSharedData;
+typedef PGrnBuildSharedData *PGrnBuildShared;
+
+#define PGrnBuildSharedGetTableScan(shared)						\
+	((ParallelTableScanDesc) ((char *) (shared) +				\
+							  BUFFERALIGN(sizeof(PGrnBuildSharedData))))
+
+extern PGDLLEXPORT void pgroonga_build_parallel_main(dsm_segment *segment,
+													 shm_toc *toc);
+
+/*
+ * LWLockNewTrancheId() allocates a new ID from the shared counter and
+ * IDs are never released. So we allocate it only once per backend and
+ * reuse it for all parallel builds.
+ */
+static int PGrnBuildLockTrancheID = 0;
+
+static int
+PGrnBuildGetLockTrancheID(void)
+{
+	if (PGrnBuildLockTrancheID == 0)
+	{
+		PGrnBuildLockTrancheID = LWLockNewTrancheId();
+		LWLockRegisterTranche(PGrnBuildLockTrancheID,
+							  PGRN_BUILD_LOCK_TRANCHE_NAME);
+	}
+	return PGrnBuildLockTrancheID;
+}
+
+static void
+PGrnBuildParallelScan(PGrnBuildShared shared,
+					  Relation heap,
+					  Relation index,
+					  IndexInfo *indexInfo,
+					  PGrnBuildState bs)
+{
+	TableScanDesc scan;
+	double nHeapTuples;
+
+	scan = table_beginscan_parallel(heap, PGrnBuildSharedGetTableScan(shared));
+	/* Only the leader reports heap blocks progress. */
+	nHeapTuples = table_index_build_scan(heap,
+										 index,
+										 indexInfo,
+										 true,
+										 bs->reportProgress,
+										 PGrnBuildCallback,
+										 bs,
+										 scan);
+
+	SpinLockAcquire(&(shared->mutex));
+	shared->nHeapTuples += nHeapTuples;
+	shared->nIndexedTuples += bs->nIndexedTuples;
+	if (bs->maxRecordSize > shared->maxRecordSize)
+		shared->maxRecordSize = bs->maxRecordSize;
+	SpinLockRelease(&(shared->mutex));
+}
+
+static double
+PGrnBuildParallel(Relation heap,
+				  Relation index,
+				  IndexInfo *indexInfo,
+				  PGrnBuildState bs,
+				  int nWorkers)
+{
+	const char *tag = "[build][parallel]";
+	ParallelContext *parallelContext;
+	Snapshot snapshot;
+	Size sharedSize;
+	PGrnBuildShared shared;
+	double nHeapTuples;
+
+	EnterParallelMode();
+	parallelContext = CreateParallelContext("pgroonga",
+											"pgroonga_build_parallel_main",
+											nWorkers);
+
+	if (indexInfo->ii_Concurrent)
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+	else
+		snapshot = SnapshotAny;
+
+	sharedSize = add_size(BUFFERALIGN(sizeof(PGrnBuildSharedData)),
+						  table_parallelscan_estimate(heap, snapshot));
+	shm_toc_estimate_chunk(&(parallelContext->estimator), sharedSize);
+	shm_toc_estimate_keys(&(parallelContext->estimator), 1);
+	InitializeParallelDSM(parallelContext);
+
+	shared = shm_toc_allocate(parallelContext->toc, sharedSize);
+	shared->insertLockTrancheID = PGrnBuildGetLockTrancheID();
+	LWLockInitialize(&(shared->insertLock), shared->insertLockTrancheID);
+	bs->insertLock = &(shared->insertLock);
+	shared->heapID = RelationGetRelid(heap);
+	shared->indexID = RelationGetRelid(index);
+	shared->isConcurrent = indexInfo->ii_Concurrent;
+	SpinLockInit(&(shared->mutex));
+	shared->nHeapTuples = 0.0;
+	shared->nIndexedTuples = 0.0;
+	shared->maxRecordSize = 0;
+	/* maintenance_work_mem is shared by the leader and all workers. */
+	shared->workMemSize = (maintenance_work_mem * 1024L) / (nWorkers + 1);
+	bs->workMemSize = shared->workMemSize;
+	table_parallelscan_initialize(heap,
+								  PGrnBuildSharedGetTableScan(shared),
+								  snapshot);
+	shm_toc_insert(parallelContext->toc, PGRN_BUILD_SHARED_KEY, shared);
+
+	LaunchParallelWorkers(parallelContext);
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: %s <%s>: <%d>/<%d>",
+			tag,
+			RelationGetRelationName(index),
+			parallelContext->nworkers_launched,
+			nWorkers);
+
+	PG_TRY();
+	{
+		PGrnBuildParallelScan(shared, heap, index, indexInfo, bs);
+		WaitForParallelWorkersToFinish(parallelContext);
+	}
+	PG_CATCH();
+	{
+		/* The caller removes Groonga objects on error. Workers must
+		 * not write to them after that. DestroyParallelContext()
+		 * terminates workers and waits for them to exit. Workers
+		 * waiting for the insert lock can't exit until it's released. */
+		if (LWLockHeldByMe(bs->insertLock))
+			LWLockRelease(bs->insertLock);
+		HOLD_INTERRUPTS();
+		DestroyParallelContext(parallelContext);
+		RESUME_INTERRUPTS();
+		bs->insertLock = NULL;
+		if (IsMVCCSnapshot(snapshot))
+			UnregisterSnapshot(snapshot);
+		ExitParallelMode();
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	nHeapTuples = shared->nHeapTuples;
+	bs->nIndexedTuples = shared->nIndexedTuples;
+	bs->maxRecordSize = shared->maxRecordSize;
+
+	DestroyParallelContext(parallelContext);
+	bs->insertLock = NULL;
+	if (IsMVCCSnapshot(snapshot))
+		UnregisterSnapshot(snapshot);
+	ExitParallelMode();
+
+	return nHeapTuples;
+}
+
+void
+pgroonga_build_parallel_main(dsm_segment *segment, shm_toc *toc)
+{
+	const char *tag = "[build][parallel][worker]";
+	PGrnBuildShared shared;
+	LOCKMODE heapLockMode;
+	LOCKMODE indexLockMode;
+	Relation heap;
+	Relation index;
+	IndexInfo *indexInfo;
+	char buildingSourcesTableName[GRN_TABLE_MAX_KEY_SIZE];
+	PGrnBuildStateData bs;
+
+	shared = shm_toc_lookup(toc, PGRN_BUILD_SHARED_KEY, false);
+	LWLockRegisterTranche(shared->insertLockTrancheID,
+						  PGRN_BUILD_LOCK_TRANCHE_NAME);
+	if (shared->isConcurrent)
+	{
+		heapLockMode = ShareUpdateExclusiveLock;
+		indexLockMode = RowExclusiveLock;
+	}
+	else
+	{
+		heapLockMode = ShareLock;
+		indexLockMode = AccessExclusiveLock;
+	}
+	heap = table_open(shared->heapID, heapLockMode);
+	index = index_open(shared->indexID, indexLockMode);
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = shared->isConcurrent;
+
+	PGrnEnsureDatabase();
+
+	snprintf(buildingSourcesTableName, sizeof(buildingSourcesTableName),
+			 PGrnBuildingSourcesTableNameFormat, index->rd_node.relNode);
+	PGrnInsertTargetInit(&(bs.target),
+						 index,
+						 PGrnLookup(buildingSourcesTableName, ERROR),
+						 NULL);
+	bs.nIndexedTuples = 0.0;
+	bs.needMaxRecordSizeUpdate = PGrnNeedMaxRecordSizeUpdate(index);
+	bs.maxRecordSize = 0;
+	bs.workMemSize = shared->workMemSize;
+	bs.reportProgress = false;
+	bs.insertLock = &(shared->insertLock);
+	bs.memoryContext =
+		AllocSetContextCreate(CurrentMemoryContext,
+							  "PGroonga parallel index build temporay context",
+							  ALLOCSET_DEFAULT_SIZES);
+
+	PGrnBuildParallelScan(shared, heap, index, indexInfo, &bs);
+	GRN_LOG(ctx, GRN_LOG_DEBUG,
+			"pgroonga: %s <%s>: <%.0f>",
+			tag,
+			RelationGetRelationName(index),
+			bs.nIndexedTuples);
+
+	MemoryContextDelete(bs.memoryContext);
+
+	index_close(index, indexLockMode);
+	table_close(heap, heapLockMode);
+}
+#endif
+
+static double
+PGrnBuildHeapScan(Relation heap,
+				  Relation index,
+				  IndexInfo *indexInfo,
+				  PGrnBuildState bs)
+{
+#ifdef PGRN_SUPPORT_PARALLEL_BUILD
+	/* WAL isn't written from parallel workers. */
+	if (!PGrnWALGetEnabled())
+	{
+		int nWorkers;
+
+		nWorkers = plan_create_index_workers(RelationGetRelid(heap),
+											 RelationGetRelid(index));
+		if (nWorkers > 0)
+			return PGrnBuildParallel(heap, index, indexInfo, bs, nWorkers);
+	}
+#endif
+
+	return PGrnIndexBuildHeapScan(heap,
+								  index,
+								  indexInfo,
+								  true,
+								  PGrnBuildCallback,
+								  bs);
+}
+
 static IndexBuildResult *
 pgroonga_build_raw(Relation heap,
 				   Relation index,
@@ -7280,11 +9324,12 @@ pgroonga_build_raw(Relation heap,
 
 	data.sourcesTable = NULL;
 
-	bs.sourcesTable = NULL;
-	bs.sourcesCtidColumn = NULL;
 	bs.nIndexedTuples = 0.0;
 	bs.needMaxRecordSizeUpdate = PGrnNeedMaxRecordSizeUpdate(index);
 	bs.maxRecordSize = 0;
+	bs.workMemSize = maintenance_work_mem * 1024L;
+	bs.reportProgress = true;
+	bs.insertLock = NULL;
 	bs.memoryContext =
 		AllocSetContextCreate(CurrentMemoryContext,
 							  "PGroonga index build temporay context",
@@ -7300,21 +9345,30 @@ pgroonga_build_raw(Relation heap,
 		data.desc = RelationGetDescr(index);
 		data.relNode = index->rd_node.relNode;
 		PGrnCreate(&data);
-		bs.sourcesTable = data.sourcesTable;
-		bs.sourcesCtidColumn = data.sourcesCtidColumn;
-		nHeapTuples = PGrnIndexBuildHeapScan(heap,
-											 index,
-											 indexInfo,
-											 true,
-											 PGrnBuildCallback,
-											 &bs);
-		PGrnSetSources(index, bs.sourcesTable);
+		PGrnInsertTargetInit(&(bs.target),
+							 index,
+							 data.sourcesTable,
+							 data.sourcesCtidColumn);
+		PGrnBuildProgressSetPhase(PGRN_BUILD_PHASE_SCAN_HEAP);
+		nHeapTuples = PGrnBuildHeapScan(heap, index, indexInfo, &bs);
+		/* Parallel workers' tuples are counted after the scan. */
+		PGrnBuildProgressSetNTuples(bs.nIndexedTuples, true);
+		/* Index columns are built statically after all records are
+		 * loaded. It's faster than updating them for each record.
+		 * Groonga may use multiple threads for it. */
+		PGrnBuildProgressSetPhase(PGRN_BUILD_PHASE_SET_SOURCES);
+		PGrnIsMaintenance = true;
+		PGrnSetSources(index, bs.target.table);
+		PGrnIsMaintenance = false;
+		PGrnBuildProgressSetPhase(PGRN_BUILD_PHASE_FINISH_SOURCES_TABLE);
 		PGrnCreateSourcesTableFinish(&data);
 	}
 	PG_CATCH();
 	{
 		size_t i, n;
 
+		PGrnIsMaintenance = false;
+
 		n = GRN_BULK_VSIZE(&lexicons) / sizeof(grn_obj *);
 		for (i = 0; i < n; i++)
 		{
@@ -7336,6 +9390,8 @@ pgroonga_build_raw(Relation heap,
 		if (data.sourcesTable)
 			grn_obj_remove(ctx, data.sourcesTable);
 
+		PGrnObjectCacheRemoveByNodeID(index->rd_node.relNode);
+
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
@@ -7350,12 +9406,35 @@ pgroonga_build_raw(Relation heap,
 
 	if (bs.needMaxRecordSizeUpdate)
 	{
+		PGrnBuildProgressSetPhase(PGRN_BUILD_PHASE_UPDATE_MAX_RECORD_SIZE);
 		PGrnUpdateMaxRecordSize(index, bs.maxRecordSize);
 	}
 
 	return result;
 }
 
+#ifdef PGRN_SUPPORT_PROGRESS
+static char *
+pgroonga_buildphasename_raw(int64 phase)
+{
+	switch (phase)
+	{
+	case PROGRESS_CREATEIDX_SUBPHASE_INITIALIZE:
+		return "initializing";
+	case PGRN_BUILD_PHASE_SCAN_HEAP:
+		return "scanning heap";
+	case PGRN_BUILD_PHASE_SET_SOURCES:
+		return "building index columns";
+	case PGRN_BUILD_PHASE_FINISH_SOURCES_TABLE:
+		return "renaming sources table";
+	case PGRN_BUILD_PHASE_UPDATE_MAX_RECORD_SIZE:
+		return "updating max record size";
+	default:
+		return NULL;
+	}
+}
+#endif
+
 /**
  * pgroonga.build() -- ambuild
  */
@@ -7432,6 +9511,8 @@ pgroonga_buildempty_raw(Relation index)
 		if (data.sourcesTable)
 			grn_obj_remove(ctx, data.sourcesTable);
 
+		PGrnObjectCacheRemoveByNodeID(index->rd_node.relNode);
+
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
@@ -7469,6 +9550,83 @@ PGrnBulkDeleteResult(IndexVacuumInfo *info, grn_obj *sourcesTable)
 	return stats;
 }
 
+/*
+ * Bulk delete processes records in batches of record ID order. Ctids
+ * of all records in a batch are decoded, then they are checked by the
+ * callback and then dead records are deleted. Unused JSONB values
+ * are cleaned up for each batch.
+ */
+#define PGRN_BULK_DELETE_BATCH_SIZE 1024
+
+typedef struct PGrnBulkDeleteBatchData
+{
+	grn_id ids[PGRN_BULK_DELETE_BATCH_SIZE];
+	uint64 packedCtids[PGRN_BULK_DELETE_BATCH_SIZE];
+	bool isDeads[PGRN_BULK_DELETE_BATCH_SIZE];
+	int n;
+} PGrnBulkDeleteBatchData;
+
+typedef PGrnBulkDeleteBatchData *PGrnBulkDeleteBatch;
+
+static double
+PGrnBulkDeleteBatchProcess(Relation index,
+						   grn_obj *sourcesTable,
+						   PGrnBulkDeleteBatch batch,
+						   IndexBulkDeleteCallback callback,
+						   void *callbackState,
+						   PGrnJSONBBulkDeleteData *jsonbData)
+{
+	const char *tag = "[bulk-delete]";
+	double nRemovedTuples = 0;
+	int i;
+
+	for (i = 0; i < batch->n; i++)
+	{
+		ItemPointerData ctid = PGrnCtidUnpack(batch->packedCtids[i]);
+		batch->isDeads[i] = callback(&ctid, callbackState);
+	}
+
+	for (i = 0; i < batch->n; i++)
+	{
+		grn_id id = batch->ids[i];
+		uint64 packedCtid = batch->packedCtids[i];
+		ItemPointerData ctid;
+
+		if (!batch->isDeads[i])
+			continue;
+
+		ctid = PGrnCtidUnpack(packedCtid);
+		GRN_LOG(ctx,
+				GRN_LOG_DEBUG,
+				"pgroonga: %s <%s>(%u): <%u>: <(%u,%u),%u>(%" PRIu64 ")",
+				tag,
+				index->rd_rel->relname.data,
+				index->rd_id,
+				id,
+				ctid.ip_blkid.bi_hi,
+				ctid.ip_blkid.bi_lo,
+				ctid.ip_posid,
+				packedCtid);
+
+		jsonbData->id = id;
+		PGrnJSONBBulkDeleteRecord(jsonbData);
+
+		grn_table_delete_by_id(ctx, sourcesTable, id);
+		PGrnWALDelete(index,
+					  sourcesTable,
+					  (const char *) &packedCtid,
+					  sizeof(uint64));
+
+		nRemovedTuples += 1;
+	}
+
+	PGrnJSONBBulkDeleteFlush(jsonbData);
+
+	batch->n = 0;
+
+	return nRemovedTuples;
+}
+
 static IndexBulkDeleteResult *
 pgroonga_bulkdelete_raw(IndexVacuumInfo *info,
 						IndexBulkDeleteResult *stats,
@@ -7480,6 +9638,7 @@ pgroonga_bulkdelete_raw(IndexVacuumInfo *info,
 	grn_obj	*sourcesTable;
 	grn_table_cursor *cursor;
 	double nRemovedTuples;
+	PGrnBulkDeleteBatch batch;
 
 	if (!PGrnIsWritable())
 	{
@@ -7491,6 +9650,8 @@ pgroonga_bulkdelete_raw(IndexVacuumInfo *info,
 						tag)));
 	}
 
+	PGrnPendingListMerge(index);
+
 	sourcesTable = PGrnLookupSourcesTable(index, WARNING);
 
 	if (!stats)
@@ -7500,10 +9661,14 @@ pgroonga_bulkdelete_raw(IndexVacuumInfo *info,
 		return stats;
 
 	nRemovedTuples = 0;
+	PGrnNWrites++;
+
+	batch = palloc(sizeof(PGrnBulkDeleteBatchData));
+	batch->n = 0;
 
 	cursor = grn_table_cursor_open(ctx, sourcesTable,
 								   NULL, 0, NULL, 0,
-								   0, -1, 0);
+								   0, -1, GRN_CURSOR_BY_ID);
 	PGrnCheck("%s failed to open cursor", tag);
 
 	PG_TRY();
@@ -7524,7 +9689,6 @@ pgroonga_bulkdelete_raw(IndexVacuumInfo *info,
 		while ((id = grn_table_cursor_next(ctx, cursor)) != GRN_ID_NIL)
 		{
 			uint64 packedCtid;
-			ItemPointerData	ctid;
 
 			CHECK_FOR_INTERRUPTS();
 
@@ -7563,33 +9727,26 @@ pgroonga_bulkdelete_raw(IndexVacuumInfo *info,
 				}
 				packedCtid = *((uint64 *) key);
 			}
-			ctid = PGrnCtidUnpack(packedCtid);
-			if (callback(&ctid, callbackState))
-			{
-				GRN_LOG(ctx,
-						GRN_LOG_DEBUG,
-						"pgroonga: %s <%s>(%u): <%u>: <(%u,%u),%u>(%" PRIu64 ")",
-						tag,
-						index->rd_rel->relname.data,
-						index->rd_id,
-						id,
-						ctid.ip_blkid.bi_hi,
-						ctid.ip_blkid.bi_lo,
-						ctid.ip_posid,
-						packedCtid);
-
-				jsonbData.id = id;
-				PGrnJSONBBulkDeleteRecord(&jsonbData);
-
-				grn_table_cursor_delete(ctx, cursor);
-				PGrnWALDelete(index,
-							  sourcesTable,
-							  (const char *) &packedCtid,
-							  sizeof(uint64));
 
-				nRemovedTuples += 1;
+			batch->ids[batch->n] = id;
+			batch->packedCtids[batch->n] = packedCtid;
+			batch->n++;
+			if (batch->n == PGRN_BULK_DELETE_BATCH_SIZE)
+			{
+				nRemovedTuples += PGrnBulkDeleteBatchProcess(index,
+															 sourcesTable,
+															 batch,
+															 callback,
+															 callbackState,
+															 &jsonbData);
 			}
 		}
+		nRemovedTuples += PGrnBulkDeleteBatchProcess(index,
+													 sourcesTable,
+													 batch,
+													 callback,
+													 callbackState,
+													 &jsonbData);
 
 		PGrnJSONBBulkDeleteFin(&jsonbData);
 
@@ -7602,6 +9759,8 @@ pgroonga_bulkdelete_raw(IndexVacuumInfo *info,
 	}
 	PG_END_TRY();
 
+	pfree(batch);
+
 	stats->tuples_removed = nRemovedTuples;
 
 	return stats;
@@ -7650,6 +9809,7 @@ PGrnRemoveUnusedTable(Oid relationFileNodeID)
 		snprintf(tableName, sizeof(tableName),
 				 PGrnSourcesTableNameFormat, relationFileNodeID);
 		PGrnRemoveObject(tableName);
+		PGrnPendingListRemoveRaw(relationFileNodeID);
 		PGrnAliasDeleteRaw(relationFileNodeID);
 		PGrnIndexStatusDeleteRaw(relationFileNodeID);
 	}
@@ -7669,6 +9829,9 @@ PGrnRemoveUnusedTable(Oid relationFileNodeID)
 	}
 
 	PGrnJSONBRemoveUnusedTables(relationFileNodeID);
+
+	PGrnConditionCacheRemoveByNodeID(relationFileNodeID);
+	PGrnObjectCacheRemoveByNodeID(relationFileNodeID);
 }
 
 void
@@ -7714,6 +9877,9 @@ pgroonga_vacuumcleanup_raw(IndexVacuumInfo *info,
 	if (!PGrnIsWritable())
 		return stats;
 
+	if (PGrnPendingListMerge(info->index) > 0)
+		PGrnNWrites++;
+
 	if (!stats)
 	{
 		grn_obj *sourcesTable;
@@ -7947,6 +10113,93 @@ PGrnCostEstimateUpdateSelectivity(Relation index,
 	}
 }
 
+static int
+PGrnCostEstimateFindPathKeyAttribute(IndexPath *path, PathKey *pathKey)
+{
+	IndexOptInfo *indexInfo = path->indexinfo;
+	ListCell *cell;
+
+	foreach(cell, pathKey->pk_eclass->ec_members)
+	{
+		EquivalenceMember *member = (EquivalenceMember *) lfirst(cell);
+		Expr *expr = member->em_expr;
+		Var *var;
+		int i;
+
+		while (IsA(expr, RelabelType))
+			expr = ((RelabelType *) expr)->arg;
+		if (!IsA(expr, Var))
+			continue;
+		var = (Var *) expr;
+		if (var->varno != indexInfo->rel->relid)
+			continue;
+
+		for (i = 0; i < indexInfo->ncolumns; i++)
+		{
+			if (indexInfo->indexkeys[i] == var->varattno)
+				return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * The plan uses the order of index columns for ORDER BY without sort
+ * when the path has path keys. Records are sorted by
+ * PGrnSortByColumn() but the order may not match the order of
+ * PostgreSQL. See PGrnIndexColumnIsSortable(). The path is disabled in
+ * the case. Then the planner sorts records by itself.
+ */
+static bool
+PGrnCostEstimateIsUnsortable(Relation index, IndexPath *path)
+{
+	TupleDesc desc = RelationGetDescr(index);
+	bool *haveKeys;
+	ListCell *cell;
+	bool isUnsortable = false;
+
+	if (path->pathkeys == NIL)
+		return false;
+
+	/* ORDER BY score */
+	if (path->indexorderbys != NIL)
+		return false;
+
+	haveKeys = palloc0(sizeof(bool) * desc->natts);
+#ifdef PGRN_SUPPORT_INDEX_CLAUSE
+	foreach(cell, path->indexclauses)
+	{
+		IndexClause *clause = (IndexClause *) lfirst(cell);
+		haveKeys[clause->indexcol] = true;
+	}
+#else
+	foreach(cell, path->indexqualcols)
+	{
+		haveKeys[lfirst_int(cell)] = true;
+	}
+#endif
+
+	/* Path keys for columns that are equal to constants are
+	 * omitted. So a path key isn't always for the same position
+	 * column. */
+	foreach(cell, path->pathkeys)
+	{
+		PathKey *pathKey = (PathKey *) lfirst(cell);
+		int i;
+
+		i = PGrnCostEstimateFindPathKeyAttribute(path, pathKey);
+		if (i < 0 || !PGrnIndexColumnIsSortable(index, i, haveKeys[i]))
+		{
+			isUnsortable = true;
+			break;
+		}
+	}
+	pfree(haveKeys);
+
+	return isUnsortable;
+}
+
 static void
 pgroonga_costestimate_internal(Relation index,
 							   PlannerInfo *root,
@@ -7979,6 +10232,12 @@ pgroonga_costestimate_internal(Relation index,
 	*indexTotalCost = 0.0; /* TODO */
 	*indexCorrelation = 0.0;
 	*indexPages = 0.0; /* TODO */
+
+	if (PGrnCostEstimateIsUnsortable(index, path))
+	{
+		*indexStartupCost += disable_cost;
+		*indexTotalCost += disable_cost;
+	}
 }
 
 static void
@@ -8071,9 +10330,16 @@ static void
 pgroonga_initparallelscan_raw(void *target)
 {
 	PGrnParallelScanDesc pgrnParallelScan = (PGrnParallelScanDesc) target;
+	int i;
+
+	for (i = 0; i < PGRN_PARALLEL_SCAN_N_SLOTS; i++)
+	{
+		pg_atomic_init_u32(&(pgrnParallelScan->owners[i]), 0);
+	}
+	pgrnParallelScan->pendingListMerged = false;
+	pg_atomic_init_u32(&(pgrnParallelScan->allOwner), 0);
 
-	SpinLockInit(&(pgrnParallelScan->mutex));
-	pgrnParallelScan->scanning = false;
+	PGrnParallelScanInitializing = pgrnParallelScan;
 }
 
 static void
@@ -8083,32 +10349,98 @@ pgroonga_parallelrescan_raw(IndexScanDesc scan)
 	PGrnParallelScanDesc pgrnParallelScan =
 		OffsetToPointer((void *) (parallelScan),
 						parallelScan->ps_offset);
+	int i;
+
+	for (i = 0; i < PGRN_PARALLEL_SCAN_N_SLOTS; i++)
+	{
+		pg_atomic_write_u32(&(pgrnParallelScan->owners[i]), 0);
+	}
 
-	pgrnParallelScan->scanning = false;
+	/* Workers aren't running yet. */
+	PGrnParallelScanMergePendingList(pgrnParallelScan,
+									 (PGrnScanOpaque) scan->opaque);
 }
 
-static bool
-PGrnParallelScanAcquire(IndexScanDesc scan)
+static void
+PGrnParallelScanMergePendingList(PGrnParallelScanDesc pgrnParallelScan,
+								 PGrnScanOpaque so)
+{
+	pg_atomic_write_u32(&(pgrnParallelScan->allOwner), 0);
+	if (PGrnIsWritable())
+	{
+		if (PGrnPendingListMerge(so->index) > 0)
+		{
+			PGrnNWrites++;
+			/* Searched records and cursors may be stale on rescan. */
+			PGrnScanOpaqueReinit(so);
+		}
+		pgrnParallelScan->pendingListMerged = true;
+	}
+	else
+	{
+		pgrnParallelScan->pendingListMerged =
+			PGrnPendingListIsEmpty(so->index);
+	}
+}
+
+static PGrnParallelScanDesc
+PGrnParallelScanGetDesc(IndexScanDesc scan)
 {
-	PGrnScanOpaque so = (PGrnScanOpaque) scan->opaque;
 	ParallelIndexScanDesc parallelScan = scan->parallel_scan;
-	PGrnParallelScanDesc pgrnParallelScan =
-		OffsetToPointer((void *) (parallelScan),
-						parallelScan->ps_offset);
-	bool acquired = false;
+	return OffsetToPointer((void *) (parallelScan),
+						   parallelScan->ps_offset);
+}
 
-	if (so->indexCursor)
-		return true;
-	if (so->tableCursor)
+static uint32
+PGrnParallelScanGetParticipant(void)
+{
+	/* ParallelWorkerNumber is -1 for the leader. */
+	return (uint32) (ParallelWorkerNumber + 2);
+}
+
+static bool
+PGrnParallelScanIsPendingListMerged(IndexScanDesc scan)
+{
+	PGrnParallelScanDesc pgrnParallelScan = PGrnParallelScanGetDesc(scan);
+	return pgrnParallelScan->pendingListMerged;
+}
+
+static bool
+PGrnParallelScanOwnAll(IndexScanDesc scan)
+{
+	PGrnParallelScanDesc pgrnParallelScan = PGrnParallelScanGetDesc(scan);
+	uint32 participant = PGrnParallelScanGetParticipant();
+	uint32 owner = 0;
+
+	if (pg_atomic_compare_exchange_u32(&(pgrnParallelScan->allOwner),
+									   &owner,
+									   participant))
 		return true;
+	return owner == participant;
+}
+
+static bool
+PGrnParallelScanOwn(IndexScanDesc scan, grn_id sourceID)
+{
+	PGrnParallelScanDesc pgrnParallelScan = PGrnParallelScanGetDesc(scan);
+	uint32 slot;
+	uint32 participant = PGrnParallelScanGetParticipant();
+	uint32 owner;
 
-	SpinLockAcquire(&(pgrnParallelScan->mutex));
-	if (!pgrnParallelScan->scanning) {
-		acquired = true;
-		pgrnParallelScan->scanning = true;
+	if (!pgrnParallelScan->pendingListMerged)
+		return PGrnParallelScanOwnAll(scan);
+
+	slot = (sourceID / PGRN_PARALLEL_SCAN_CHUNK_SIZE) %
+		PGRN_PARALLEL_SCAN_N_SLOTS;
+	owner = pg_atomic_read_u32(&(pgrnParallelScan->owners[slot]));
+	if (owner == 0)
+	{
+		if (pg_atomic_compare_exchange_u32(&(pgrnParallelScan->owners[slot]),
+										   &owner,
+										   participant))
+			return true;
 	}
-	SpinLockRelease(&(pgrnParallelScan->mutex));
-	return acquired;
+	return owner == participant;
 }
 
 Datum
@@ -8153,6 +10485,9 @@ pgroonga_handler(PG_FUNCTION_ARGS)
 	routine->ammarkpos = NULL;
 	routine->amrestrpos = NULL;
 	routine->ambuild = pgroonga_build_raw;
+#ifdef PGRN_SUPPORT_PROGRESS
+	routine->ambuildphasename = pgroonga_buildphasename_raw;
+#endif
 	routine->ambuildempty = pgroonga_buildempty_raw;
 	routine->ambulkdelete = pgroonga_bulkdelete_raw;
 	routine->amvacuumcleanup = pgroonga_vacuumcleanup_raw;
@@ -65,8 +65,10 @@
 #define PGrnRegexpInStrategyV2Number		35
 /* operator !&^| (multiple conditions of not prefix search) */
 #define PGrnNotPrefixInStrategyV2Number		36
+/* operator <&@~> (ORDER BY score of query in Groonga) */
+#define PGrnQueryScoreDistanceStrategyV2Number	37
 
-#define PGRN_N_STRATEGIES PGrnNotPrefixInStrategyV2Number
+#define PGRN_N_STRATEGIES PGrnQueryScoreDistanceStrategyV2Number
 
 /* file and table names */
 #define PGrnLogPathDefault				"pgroonga.log"
@@ -75,6 +77,8 @@
 #define PGrnBuildingSourcesTableNamePrefix	"BuildingSources"
 #define PGrnBuildingSourcesTableNamePrefixLength	(sizeof(PGrnBuildingSourcesTableNamePrefix) - 1)
 #define PGrnBuildingSourcesTableNameFormat	PGrnBuildingSourcesTableNamePrefix "%u"
+#define PGrnPendingSourcesTableNamePrefix	"PendingSources"
+#define PGrnPendingSourcesTableNameFormat	PGrnPendingSourcesTableNamePrefix "%u"
 #define PGrnSourcesTableNamePrefix		"Sources"
 #define PGrnSourcesTableNamePrefixLength	(sizeof(PGrnSourcesTableNamePrefix) - 1)
 #define PGrnSourcesTableNameFormat		PGrnSourcesTableNamePrefix "%u"
@@ -0,0 +1,43 @@
+require_relative "helpers/sandbox"
+
+class PendingListTestCase < Test::Unit::TestCase
+  include Helpers::Sandbox
+
+  test "concurrent insert and merge" do
+    run_sql("CREATE TABLE memos (id integer, content text);")
+    run_sql("CREATE INDEX memos_content ON memos " +
+            "USING pgroonga (content) " +
+            "WITH (fast_update = true);")
+
+    n_writers = 4
+    n_records = 1000
+    writers = n_writers.times.collect do |i|
+      Thread.new do
+        run_sql(<<-SQL)
+SET pgroonga.pending_list_limit = 10;
+INSERT INTO memos
+  SELECT id, 'PGroonga is good! ' || id
+    FROM generate_series(#{i * n_records + 1},
+                         #{(i + 1) * n_records}) AS id;
+        SQL
+      end
+    end
+    writers.each(&:join)
+
+    select = <<-SQL
+SET enable_seqscan = no;
+SET enable_bitmapscan = no;
+SELECT count(*) FROM memos WHERE content &@ 'PGroonga';
+    SQL
+    output = <<-OUTPUT
+#{select}
+ count 
+-------
+  #{n_writers * n_records}
+(1 row)
+
+    OUTPUT
+    assert_equal([output, ""],
+                 run_sql(select))
+  end
+end